@@ -0,0 +1,189 @@
+#include <avr/boot.h>
+#include <avr/eeprom.h>
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <util/crc16.h>
+
+#include "boot.h"
+#include "config.h"
+#include "reg.h"
+
+/**
+ * Bootloader serial, gravado na seção de boot (ver `include/boot.h`).
+ *
+ * A verificação do pedido de atualização é feita em `.init3`, logo depois de
+ * a pilha ser configurada e antes de a RAM ser zerada (o pedido fica na RAM).
+ * Sem pedido, o salto para o programa acontece ali mesmo, sem passar pelo
+ * resto da inicialização do C.
+ *
+ * Com o pedido, a USART é configurada em `BOOT_BAUD_RATE`, 8N1, e o
+ * bootloader atende os comandos do host por polling, sem interrupções. A
+ * 125000 baud chega um byte a cada 80 ciclos, o que basta para o CRC e a
+ * cópia de cada byte. A escrita de uma página (apagamento e gravação, cerca
+ * de 9 ms) só começa depois de a página inteira ter sido recebida, e o host
+ * espera a resposta antes de enviar a próxima, então nenhum byte chega
+ * durante a escrita.
+ *
+ * Uma página só é apagada e gravada caso seja diferente da que já está na
+ * flash, o que também poupa os ciclos de escrita da flash quando o host não
+ * compara os CRCs antes.
+ */
+
+
+// Configuração do UCSR0B: transmissor e receptor habilitados, sem
+// interrupções
+#define UCSR0B_CONFIG REG_CONFIG(UCSR0B,                                        \
+    REG_FIELD(UCSR0B_RXEN0, 1),                                                 \
+    REG_FIELD(UCSR0B_TXEN0, 1))
+
+
+// Salta para o vetor de reset do programa
+static inline void run_application(void) {
+    __asm__ __volatile__ ("jmp 0");
+}
+
+// Decide, logo após o reset, se o bootloader continua ou se o programa é
+// executado. A função não tem prólogo, então não pode utilizar a pilha
+__attribute__((naked, used, section(".init3")))
+void boot_check(void) {
+    uint8_t reset = MCUSR;
+    MCUSR = 0;
+    // O watchdog continua ligado depois de um reset por ele (sequência
+    // temporizada)
+    WDTCSR = (1<<WDCE) | (1<<WDE);
+    WDTCSR = 0b00000000;
+
+    volatile uint16_t *request = (volatile uint16_t *) BOOT_REQUEST_ADDRESS;
+    bool requested = (reset & (1<<WDRF)) && *request == BOOT_REQUEST_MAGIC;
+    *request = 0;
+
+    // Pull-up no RXD, para que a linha desconectada não seja lida como um
+    // break. A leitura é feita depois da sincronização do pino (um ciclo)
+    PORTD = 1<<PORTD0;
+    __asm__ __volatile__ ("nop");
+    bool held = !(PIND & (1<<PIND0));
+    PORTD = 0b00000000;
+
+    bool empty = pgm_read_word(0) == 0xFFFF;
+
+    if (!requested && !held && !empty) {
+        run_application();
+    }
+}
+
+
+static uint8_t receive(void) {
+    while (!(UCSR0A & (1<<RXC0))) { }
+    return UDR0;
+}
+
+static void transmit(uint8_t data) {
+    while (!(UCSR0A & (1<<UDRE0))) { }
+    UDR0 = data;
+}
+
+// CRC-16 (XMODEM) de uma página da flash
+static uint16_t page_crc(uint16_t address) {
+    uint16_t crc = 0;
+    for (uint8_t i = 0; i < SPM_PAGESIZE; ++i) {
+        crc = _crc_xmodem_update(crc, pgm_read_byte(address + i));
+    }
+    return crc;
+}
+
+// Página recebida do host
+static uint8_t page[SPM_PAGESIZE];
+
+// Recebe uma página e o seu CRC, e a grava caso esteja correta e seja
+// diferente da que está na flash. Retorna a resposta ao host
+static uint8_t write_page(void) {
+    uint8_t index = receive();
+    uint16_t crc = 0;
+    for (uint8_t i = 0; i < SPM_PAGESIZE; ++i) {
+        page[i] = receive();
+        crc = _crc_xmodem_update(crc, page[i]);
+    }
+    uint16_t expected = receive();
+    expected |= receive() << 8;
+    if (crc != expected || index >= BOOT_APP_PAGES) {
+        return BOOT_BAD_CRC;
+    }
+
+    uint16_t address = index * SPM_PAGESIZE;
+    bool same = true;
+    for (uint8_t i = 0; i < SPM_PAGESIZE; ++i) {
+        same &= pgm_read_byte(address + i) == page[i];
+    }
+    if (same) {
+        return BOOT_SAME;
+    }
+
+    // A flash não pode ser escrita enquanto a EEPROM estiver sendo escrita
+    eeprom_busy_wait();
+    boot_page_erase(address);
+    boot_spm_busy_wait();
+    for (uint8_t i = 0; i < SPM_PAGESIZE; i += 2) {
+        boot_page_fill(address + i, page[i] | page[i+1] << 8);
+    }
+    boot_page_write(address);
+    boot_spm_busy_wait();
+    // A área do programa volta a poder ser lida
+    boot_rww_enable();
+
+    for (uint8_t i = 0; i < SPM_PAGESIZE; ++i) {
+        if (pgm_read_byte(address + i) != page[i]) {
+            return BOOT_BAD_WRITE;
+        }
+    }
+    return BOOT_OK;
+}
+
+
+int main(void) {
+    // Modo assíncrono, velocidade dobrada, 8N1 (valor de reset do UCSR0C)
+    UCSR0A = REG_CONFIG(UCSR0A, REG_FIELD(UCSR0A_U2X0, 1));
+    UBRR0 = CPU_CLOCK / 8 / BOOT_BAUD_RATE - 1;
+    UCSR0B = UCSR0B_CONFIG;
+
+    // Bytes que não são comandos são ignorados, o que permite ao host
+    // ressincronizar enviando `BOOT_INFO` até receber a resposta
+    for (;;) {
+        switch (receive()) {
+            case BOOT_INFO:
+                transmit(BOOT_VERSION);
+                transmit(SPM_PAGESIZE / 2);
+                transmit(BOOT_APP_PAGES);
+                break;
+
+            case BOOT_CRC: {
+                uint16_t crc = page_crc(receive() * SPM_PAGESIZE);
+                transmit(crc);
+                transmit(crc >> 8);
+                break;
+            }
+
+            case BOOT_WRITE:
+                transmit(write_page());
+                break;
+
+            case BOOT_RUN:
+                // A resposta termina de sair antes do salto, e a USART volta
+                // ao estado de reset para o programa
+                UCSR0A = REG_CONFIG(UCSR0A,
+                    REG_FIELD(UCSR0A_TXC0, 1),
+                    REG_FIELD(UCSR0A_U2X0, 1));
+                transmit(BOOT_OK);
+                while (!(UCSR0A & (1<<TXC0))) { }
+                UCSR0B = 0b00000000;
+                UCSR0A = 0b00000000;
+                UBRR0 = 0;
+                run_application();
+                break;
+
+            default:
+                break;
+        }
+    }
+}
@@ -0,0 +1,21 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+/**
+ * Medição do custo, em ciclos, das operações das filas (`ring.h`) e do
+ * processamento das amostras.
+ *
+ * Só é compilada com `-DBENCHMARK` (ambiente `benchmark` do platformio.ini).
+ * Nesse caso, `benchmark_run` é chamada na inicialização e transmite os
+ * resultados pela serial no formato "#bench_<operação> <ciclos>", antes de o
+ * programa começar. Os ciclos são medidos pela base de tempo (Timer1 com
+ * prescaler de 1), descontando o custo da própria medição, e podem ser
+ * obtidos no simavr com `tools/sim.c -s ""`. Operações mais longas que uma
+ * volta do Timer1 (a FFT) são medidas contando as suas voltas. Compilando
+ * também com `-DDEBUG_UART`, é medido o custo dos registros do log
+ * (`log.h`).
+ */
+
+void benchmark_run(void);
+
+#endif
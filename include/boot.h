@@ -0,0 +1,87 @@
+#ifndef BOOT_H
+#define BOOT_H
+
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#include <stdint.h>
+
+/**
+ * Interface entre o programa e o bootloader serial (`bootloader/`).
+ *
+ * O bootloader fica na seção de boot (os últimos `BOOT_SECTION_SIZE` bytes da
+ * flash, fuses BOOTSZ = 01 e BOOTRST programado), então é executado a cada
+ * reset. Sem um pedido de atualização, ele salta para o programa logo em
+ * `.init3`, antes mesmo de zerar a RAM, e o boot fica só alguns ciclos mais
+ * longo. Ele fica esperando o host quando:
+ *
+ * - o programa pediu a atualização (comando 'B', ver `boot_request`), que
+ *   grava `BOOT_REQUEST_MAGIC` no fim da RAM e reseta pelo watchdog;
+ * - o pino RXD está em 0 no reset (o host mantém um break na linha), o que
+ *   recupera uma placa cujo programa não responde aos comandos;
+ * - não há programa (o vetor de reset está apagado).
+ *
+ * O host transmite o programa em `BOOT_BAUD_RATE`, em páginas de
+ * `SPM_PAGESIZE` bytes, cada uma com o seu CRC-16 (XMODEM). Antes, ele lê o
+ * CRC de cada página já gravada, e só transmite as que mudaram. Comandos
+ * (cada um é um byte, seguido dos argumentos):
+ *
+ *     BOOT_INFO               versão, tamanho da página / 2 e quantidade de
+ *                             páginas do programa
+ *     BOOT_CRC <página>       CRC da página gravada (2 bytes, little-endian)
+ *     BOOT_WRITE <página> <dados> <CRC>
+ *                             grava a página, caso o CRC esteja correto e ela
+ *                             seja diferente da gravada, e responde
+ *                             `BOOT_OK`, `BOOT_SAME`, `BOOT_BAD_CRC` ou
+ *                             `BOOT_BAD_WRITE` (a leitura depois da escrita
+ *                             não confere)
+ *     BOOT_RUN                responde `BOOT_OK` e salta para o programa
+ *
+ * Ver `tools/flash.c` para o lado do host.
+ */
+
+
+// Tamanho da seção de boot, em bytes (BOOTSZ = 01: 1024 words), e o início,
+// que também é o fim da área do programa
+#define BOOT_SECTION_SIZE 2048
+#define BOOT_SECTION_START (FLASHEND + 1 - BOOT_SECTION_SIZE)
+
+// Quantidade de páginas da área do programa
+#define BOOT_APP_PAGES (BOOT_SECTION_START / SPM_PAGESIZE)
+
+// Baud rate do bootloader. Com clock de 1 MHz e velocidade dobrada, 125000 é
+// o maior baud rate possível (UBRR0 = 0), e não tem erro de arredondamento
+#define BOOT_BAUD_RATE 125000
+
+// Versão do protocolo do bootloader
+#define BOOT_VERSION 1
+
+// Endereço e valor do pedido de atualização. Os dois últimos bytes da RAM
+// são o fundo da pilha do programa, que não é mais utilizada depois do
+// pedido, e não são tocados pelo bootloader antes da verificação
+#define BOOT_REQUEST_ADDRESS (RAMEND - 1)
+#define BOOT_REQUEST_MAGIC 0xB007
+
+// Comandos do host
+#define BOOT_INFO 'I'
+#define BOOT_CRC 'C'
+#define BOOT_WRITE 'W'
+#define BOOT_RUN 'R'
+
+// Respostas do bootloader
+#define BOOT_OK 'K'
+#define BOOT_SAME 'S'
+#define BOOT_BAD_CRC 'E'
+#define BOOT_BAD_WRITE 'F'
+
+
+// Pede a atualização ao bootloader, resetando pelo watchdog. Não retorna
+static inline void boot_request(void) {
+    cli();
+    *(volatile uint16_t *) BOOT_REQUEST_ADDRESS = BOOT_REQUEST_MAGIC;
+    // Watchdog em modo de reset, com o menor período (sequência temporizada)
+    WDTCSR = (1<<WDCE) | (1<<WDE);
+    WDTCSR = (1<<WDE);
+    for (;;) { }
+}
+
+#endif
@@ -0,0 +1,216 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <stdint.h>
+
+/**
+ * Configuração do programa, salva na EEPROM.
+ *
+ * Na inicialização, `config_load` lê a configuração salva e a valida pela
+ * versão e pelo CRC. Caso a EEPROM esteja vazia ou corrompida, são utilizados
+ * os valores padrão abaixo, que podem ser alterados na compilação (por
+ * exemplo, `-DAUTO_START=1`). A configuração em RAM pode ser alterada por
+ * comandos na serial e só é gravada na EEPROM com `config_save`.
+ */
+
+
+// Frequência da CPU (em Hz)
+#define CPU_CLOCK 1000000
+
+// Baud rate da comunicação serial (em Hz)
+#ifndef BAUD_RATE
+#define BAUD_RATE 9600
+#endif
+
+// Baud rate da serial de depuração (ver `debug.h`, em Hz)
+#ifndef DEBUG_BAUD_RATE
+#define DEBUG_BAUD_RATE 9600
+#endif
+
+// Baud rate utilizado na leitura do log da EEPROM (em Hz). Com clock de 1 MHz e
+// velocidade dobrada, 125000 é o maior baud rate possível (UBRR0 = 0), e não
+// tem erro de arredondamento
+#define DUMP_BAUD_RATE 125000
+
+// Endereço de 7 bits do ATmega328p como escravo no barramento TWI (I2C)
+#ifndef TWI_ADDRESS
+#define TWI_ADDRESS 0x28
+#endif
+
+// Endereço padrão da placa no barramento multiponto (ver `usart.h`), de 1 a
+// 255 (0 é o endereço de broadcast)
+#ifndef MULTIDROP_ADDRESS
+#define MULTIDROP_ADDRESS 1
+#endif
+
+// Quantidade de canais analógicos amostrados: ADC0 e, no medidor de energia,
+// ADC1 (ver `meter.h`)
+#define CHANNELS_NUMBER 2
+
+// Tabela de linearização padrão de todos os canais (ver `linearize.h`)
+#ifndef LINEARIZE_TABLE
+#define LINEARIZE_TABLE 0
+#endif
+
+// Janela padrão do filtro de mediana de todos os canais (ver `median.h`). 1
+// desliga o filtro
+#ifndef MEDIAN_WINDOW
+#define MEDIAN_WINDOW 1
+#endif
+
+// Nível médio e histerese padrão da detecção de eventos (em LSB, ver
+// `detector.h`)
+#ifndef EVENTS_MIDDLE
+#define EVENTS_MIDDLE 512
+#endif
+#ifndef EVENTS_HYSTERESIS
+#define EVENTS_HYSTERESIS 8
+#endif
+
+// Largura padrão das faixas do histograma, em potência de 2 (2^4 = 16 LSB,
+// 64 faixas), e o período padrão da sua transmissão (em segundos, 0 só
+// transmite pelo comando 'q')
+#ifndef HISTOGRAM_SHIFT
+#define HISTOGRAM_SHIFT 4
+#endif
+#ifndef HISTOGRAM_PERIOD
+#define HISTOGRAM_PERIOD 60
+#endif
+
+// Identificação padrão da calibração da placa, informada no cabeçalho do
+// stream para que o host escolha os coeficientes correspondentes
+#ifndef CALIBRATION_ID
+#define CALIBRATION_ID 0
+#endif
+
+// Taxa de amostragem padrão do sinal analógico (em Hz)
+#ifndef SAMPLING_RATE
+#define SAMPLING_RATE 125
+#endif
+
+// Ciclos de CPU de uma conversão disparada pelo Timer0: 13,5 ciclos do clock
+// do ADC, com prescaler de 16
+#define ADC_CONVERSION_CYCLES 216
+
+// Maior latência da interrupção do ADC até a limpeza da flag OCF0A (em ciclos
+// de CPU): a rotina da serial de depuração, que não aninha, ou o maior bloco
+// atômico do contexto principal, mais a resposta à interrupção e o prólogo
+// (ver `interrupts.h`). Pode ser conferida com `tools/sim.c`
+#define ADC_LATENCY_MAX_CYCLES 100
+
+// Limites da taxa de amostragem (em Hz). O mínimo é dado pelo maior TOP do
+// Timer0 com o maior prescaler. No máximo, a conversão e a latência da
+// interrupção do ADC cabem em um período, para que a flag OCF0A seja limpa
+// antes do próximo compare match, cuja borda de subida dispara a próxima
+// conversão. O período pode ser até um tick do prescaler de 8 mais curto,
+// pelo arredondamento do TOP
+#define SAMPLING_RATE_MIN 4
+#define SAMPLING_RATE_MAX 3000
+
+_Static_assert(CPU_CLOCK / SAMPLING_RATE_MAX - 8 >= ADC_CONVERSION_CYCLES + ADC_LATENCY_MAX_CYCLES,
+    "a conversão e a latência do ADC devem caber no período da taxa máxima");
+
+// Limites padrão da taxa de amostragem no modo adaptativo (em Hz). O máximo
+// padrão é a maior taxa cujo stream de texto cabe em `BAUD_RATE`
+#ifndef ADAPTIVE_RATE_MIN
+#define ADAPTIVE_RATE_MIN 15
+#endif
+#ifndef ADAPTIVE_RATE_MAX
+#define ADAPTIVE_RATE_MAX 125
+#endif
+
+// Limiares da atividade do sinal no modo adaptativo: a média da variação
+// absoluta entre amostras consecutivas (em LSB) acima da qual a taxa é
+// dobrada, e abaixo da qual ela é reduzida à metade. A razão entre eles é
+// maior que 2, para que a própria mudança de taxa não cause a mudança oposta
+#define ADAPTIVE_HIGH 8
+#define ADAPTIVE_LOW 2
+
+// Setpoint e ganhos Q8.8 padrão do controle PID (ver `pid.h`)
+#ifndef CONTROL_SETPOINT
+#define CONTROL_SETPOINT 512
+#endif
+#ifndef CONTROL_KP
+#define CONTROL_KP 256
+#endif
+#ifndef CONTROL_KI
+#define CONTROL_KI 16
+#endif
+#ifndef CONTROL_KD
+#define CONTROL_KD 0
+#endif
+
+// Indica se a amostragem começa na inicialização, sem esperar o comando '1'
+#ifndef AUTO_START
+#define AUTO_START 0
+#endif
+
+// Versão do formato da configuração. Deve ser incrementada a cada mudança em
+// `struct config`, para que uma configuração antiga não seja interpretada
+// com o formato novo
+#define CONFIG_VERSION 11
+
+// Flags da configuração
+#define CONFIG_AUTO_START (1<<0)
+// Indica se as amostras são salvas no log da EEPROM enquanto não estão sendo
+// transmitidas
+#define CONFIG_LOGGING (1<<1)
+// Indica se a taxa de amostragem acompanha a atividade do sinal
+#define CONFIG_ADAPTIVE (1<<2)
+// Indica se o controle PID está ligado (ver `pid.h`)
+#define CONFIG_CONTROL (1<<3)
+// Indica se o stream transmite o setpoint, a medida e a saída do controle, em
+// vez de só a amostra
+#define CONFIG_TELEMETRY (1<<4)
+// Indica se a tensão (ADC0) e a corrente (ADC1) são amostradas alternadamente
+// pelo medidor de energia, que transmite um registro por segundo em vez das
+// amostras (ver `meter.h`)
+#define CONFIG_METER (1<<5)
+// Indica se o stream transmite o espectro de cada bloco de amostras de ADC0,
+// em vez das amostras (ver `fft.h`)
+#define CONFIG_SPECTRUM (1<<6)
+// Indica se o stream transmite os cruzamentos do nível médio e os picos de
+// ADC0, em vez das amostras (ver `detector.h`)
+#define CONFIG_EVENTS (1<<7)
+
+
+struct config {
+    uint8_t version;
+    uint8_t flags;
+    // Taxa de amostragem (em Hz)
+    uint16_t sampling_rate;
+    // Limites da taxa de amostragem no modo adaptativo (em Hz)
+    uint16_t adaptive_min;
+    uint16_t adaptive_max;
+    // Setpoint (na escala do ADC) e ganhos Q8.8 do controle PID
+    uint16_t setpoint;
+    int16_t kp;
+    int16_t ki;
+    int16_t kd;
+    // Tabela de linearização de cada canal (ver `linearize.h`)
+    uint8_t linearize[CHANNELS_NUMBER];
+    // Janela do filtro de mediana de cada canal (ver `median.h`)
+    uint8_t median[CHANNELS_NUMBER];
+    // Nível médio e histerese da detecção de eventos (em LSB)
+    uint16_t events_middle;
+    uint16_t events_hysteresis;
+    // Largura das faixas do histograma (em potência de 2) e período da sua
+    // transmissão (em segundos)
+    uint8_t histogram_shift;
+    uint16_t histogram_period;
+    // Identificação da calibração da placa
+    uint16_t calibration_id;
+    // Endereço da placa no barramento multiponto
+    uint8_t bus_address;
+};
+
+extern struct config config;
+
+
+// Carrega a configuração da EEPROM, ou os valores padrão caso ela seja inválida
+void config_load(void);
+
+// Grava a configuração atual na EEPROM (apenas os bytes alterados são escritos)
+void config_save(void);
+
+#endif
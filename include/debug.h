@@ -0,0 +1,96 @@
+#ifndef DEBUG_H
+#define DEBUG_H
+
+#include <avr/io.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ring.h"
+
+/**
+ * Serial de depuração, só de transmissão, no pino OC1B (PB2), independente da
+ * USART e do stream de amostras.
+ *
+ * Só é compilada com `-DDEBUG_UART` (ambiente `debug` do platformio.ini), e
+ * transmite os registros binários do log (`log.h`), cujas macros não geram
+ * código sem ela.
+ *
+ * Os bytes são colocados em uma fila e transmitidos pela interrupção de
+ * compare match B do Timer1, a base de tempo, que conta livremente com
+ * prescaler de 1. A cada interrupção, o OCR1B é avançado até a próxima
+ * mudança de nível da linha, e o modo da saída OC1B (zerar ou setar no
+ * compare match) é escolhido pelo novo nível. A borda é gerada pelo próprio
+ * timer, então a latência da interrupção (o ADC, por exemplo) não causa
+ * jitter, desde que a interrupção comece antes da borda seguinte. Bits iguais
+ * em sequência não precisam de interrupção: um frame 8N1 custa de 2 (0x00 e
+ * 0xFF) a 10 (0x55) interrupções.
+ *
+ * Quando a interrupção começa tarde demais para a próxima borda, o frame é
+ * abortado com a linha em 1, que fica em repouso por um frame inteiro para que
+ * o receptor se ressincronize, e o atraso é contado. O bit deve então ser
+ * maior que a maior latência do vetor TIMER1_COMPB, que pode ser medida no
+ * simavr com `tools/sim.c -d <baud>`. O mesmo comando decodifica a saída e
+ * informa o custo, em ciclos de CPU por byte, e a fração da CPU gasta na
+ * transmissão contínua. A 9600 baud (`DEBUG_BAUD_RATE`), o bit tem 104
+ * ciclos.
+ *
+ * Como tanto o contexto principal quanto as interrupções inserem registros na
+ * fila, toda inserção é feita com as interrupções desabilitadas, e um registro
+ * é inserido inteiro, ou descartado e contado caso não caiba, em vez de
+ * bloquear o programa.
+ *
+ * Enquanto a serial de depuração está compilada, o Timer1 é requisitado
+ * permanentemente ao gerenciador de energia (`POWER_TIMER1`), então a CPU
+ * dorme no máximo em idle. Liberá-lo na interrupção, ao fim da transmissão,
+ * exigiria uma chamada de função, e o salvamento dos registradores que ela
+ * obriga em todas as interrupções.
+ */
+
+
+// Estatísticas da serial de depuração
+struct debug_stats {
+    // Registros do log descartados por falta de espaço na fila
+    uint16_t records_dropped;
+    // Frames abortados por uma interrupção atrasada
+    uint16_t late;
+};
+
+
+#ifdef DEBUG_UART
+
+// Fila de transmissão
+RING_DEFINE(debug_ring, uint8_t, 64)
+
+extern struct debug_ring debug_ring;
+extern struct debug_stats debug_stats;
+
+// Indica se a interrupção está transmitindo
+extern volatile bool debug_busy;
+
+// Antecedência, em ciclos, com que a interrupção é programada por
+// `debug_kick`
+#define DEBUG_KICK_CYCLES 16
+
+// Inicia a transmissão dos bytes colocados na fila, caso ela esteja parada:
+// a interrupção é programada para daqui a pouco, e começa o primeiro frame.
+// Chamada com as interrupções desabilitadas
+static inline void debug_kick(void) {
+    if (!debug_busy) {
+        debug_busy = true;
+        OCR1B = TCNT1 + DEBUG_KICK_CYCLES;
+        // Descarta os compare matches que aconteceram com a transmissão parada
+        TIFR1 = 1<<OCF1B;
+        TIMSK1 |= 1<<OCIE1B;
+    }
+}
+
+// Configura o Timer1 e o pino OC1B. Deve ser chamada depois de configurar a
+// porta B, com as interrupções desabilitadas
+void debug_init(void);
+
+// Copia as estatísticas para `stats` e as zera
+void debug_read_stats(struct debug_stats *stats);
+
+#endif
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef DETECTOR_H
+#define DETECTOR_H
+
+#include <stdint.h>
+
+/**
+ * Detecção de cruzamentos do nível médio e de picos de um sinal periódico,
+ * transmitidos como eventos em vez das amostras.
+ *
+ * O sinal é comparado a um nível médio `middle` com histerese: ele só passa a
+ * ser considerado acima do nível ao atingir `middle + hysteresis`, e abaixo
+ * ao atingir `middle - hysteresis`, então o ruído em torno do nível não gera
+ * cruzamentos falsos. O instante do cruzamento, no entanto, é o da passagem
+ * pelo próprio nível médio, interpolado linearmente entre as duas amostras
+ * vizinhas.
+ *
+ * Entre dois cruzamentos, é procurado o extremo do meio ciclo: o máximo acima
+ * do nível (pico) e o mínimo abaixo dele (vale). A posição e o valor do
+ * extremo são refinados pela parábola que passa pela amostra extrema e pelas
+ * suas duas vizinhas. O extremo é emitido quando o meio ciclo termina, logo
+ * antes do cruzamento seguinte, então os eventos saem em ordem de tempo.
+ *
+ * Os instantes são dados em períodos de amostragem, com 8 bits fracionários
+ * (256 é uma amostra depois do instante 0), em 32 bits, e os valores em LSB
+ * do ADC. A frequência do sinal é a taxa dividida pelo intervalo entre dois
+ * cruzamentos no mesmo sentido, e a amplitude é a metade da diferença entre
+ * um pico e um vale.
+ *
+ * Este módulo não depende do AVR, para ser compilado também no host, como
+ * `pipeline.h`.
+ */
+
+
+// Tipos de eventos, que também são o primeiro caractere da linha formatada
+#define DETECTOR_RISING 'u'
+#define DETECTOR_FALLING 'd'
+#define DETECTOR_PEAK 'p'
+#define DETECTOR_VALLEY 'v'
+
+// Quantidade máxima de eventos gerados por uma amostra
+#define DETECTOR_EVENTS_MAX 2
+
+// Quantidade máxima de bytes de um evento formatado
+#define DETECTOR_EVENT_MAX 19
+
+
+struct detector_event {
+    uint8_t type;
+    // Instante, em períodos de amostragem com 8 bits fracionários
+    uint32_t time;
+    // Valor do extremo (só nos picos e vales)
+    uint16_t value;
+};
+
+
+// Recomeça a detecção, com o nível médio e a histerese dados (em LSB)
+void detector_reset(uint16_t middle, uint16_t hysteresis);
+
+// Processa a amostra tomada no instante `time` (em períodos de amostragem,
+// sem parte fracionária). Retorna a quantidade de eventos escritos em `events`
+uint8_t detector_add(
+    uint32_t time, uint16_t sample, struct detector_event events[DETECTOR_EVENTS_MAX]
+);
+
+// Formata um evento como a linha "<tipo><instante>\r\n", ou
+// "<tipo><instante>,<valor>\r\n" nos picos e vales. Retorna a quantidade de
+// bytes escritos
+uint8_t detector_format(const struct detector_event *event, uint8_t out[DETECTOR_EVENT_MAX]);
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef EEPROM_LOG_H
+#define EEPROM_LOG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Registro circular de amostras na EEPROM, utilizado enquanto o host não está
+ * recebendo o stream.
+ *
+ * As amostras são agrupadas em registros de tamanho fixo (`EEPROM_LOG_RECORD_SIZE`
+ * bytes), comprimidos com codificação delta:
+ *
+ *     byte  0-1   número de sequência (little-endian)
+ *     byte  2     quantidade de amostras no registro (1 a 26)
+ *     byte  3-4   primeira amostra (little-endian)
+ *     byte  5-29  diferença de cada amostra para a anterior (int8)
+ *     byte  30    não utilizado (0)
+ *     byte  31    CRC-8 (CCITT) dos bytes 0 a 30
+ *
+ * Um registro é fechado quando fica cheio ou quando a diferença entre duas
+ * amostras não cabe em 8 bits. Os registros são escritos em sequência nas
+ * `EEPROM_LOG_RECORDS` posições da área do log, voltando ao início depois da
+ * última, então o desgaste é distribuído igualmente por todas as posições. No
+ * primeiro uso do log, a posição mais recente é encontrada procurando o registro
+ * válido cujo sucessor não tem o número de sequência seguinte, o que funciona
+ * mesmo depois de o número de sequência dar a volta.
+ *
+ * A escrita é feita pela interrupção de EEPROM pronta, um byte por vez (cerca
+ * de 3,4 ms cada), então a amostragem nunca espera pela EEPROM. Bytes que já
+ * têm o valor desejado não são reescritos. Caso um registro seja fechado
+ * enquanto o anterior ainda está sendo escrito, ele é descartado e contado em
+ * `eeprom_log_dropped`.
+ */
+
+
+// Tamanho de cada registro e quantidade de registros na EEPROM
+#define EEPROM_LOG_RECORD_SIZE 32
+#define EEPROM_LOG_RECORDS 31
+
+// Quantidade máxima de amostras em um registro
+#define EEPROM_LOG_SAMPLES 26
+
+
+// Quantidade de registros descartados desde a inicialização
+extern uint16_t eeprom_log_dropped;
+
+
+// Adiciona uma amostra ao registro atual
+void eeprom_log_add(uint16_t sample);
+
+// Fecha o registro atual, mesmo que não esteja cheio
+void eeprom_log_flush(void);
+
+// Indica se há um registro sendo escrito na EEPROM
+bool eeprom_log_busy(void);
+
+// Lê o `i`-ésimo registro, a partir do mais antigo. Retorna falso caso a
+// posição não contenha um registro válido
+bool eeprom_log_read(uint8_t i, uint8_t record[EEPROM_LOG_RECORD_SIZE]);
+
+#endif
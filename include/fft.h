@@ -0,0 +1,49 @@
+#ifndef FFT_H
+#define FFT_H
+
+#include <stdint.h>
+
+/**
+ * FFT de blocos de amostras, em ponto fixo, para o espectro do sinal.
+ *
+ * É uma FFT radix-2 com decimação no tempo, de `FFT_POINTS` pontos (64 ou
+ * 128), sobre valores Q15 de 16 bits. Antes da transformada, o nível DC do
+ * bloco é removido e é aplicada a janela de Hann. Cada estágio divide o
+ * resultado por 2, então a saída nunca transborda e fica dividida por N. Os
+ * senos e a janela ficam em tabelas na flash.
+ *
+ * O resultado é a magnitude de cada uma das `FFT_BINS` primeiras frequências
+ * (de 0 até a de Nyquist, exclusive), com resolução de taxa / N Hz. Uma
+ * senoide de amplitude A (em LSB) centrada em uma frequência resulta em cerca
+ * de 4A nela (o ganho de `FFT_INPUT_SHIFT`, 16, vezes o ganho coerente da
+ * janela, 1/2, vezes 1/2 por ser um sinal real).
+ *
+ * A parte real é calculada no próprio bloco, e só a parte imaginária ocupa um
+ * buffer à parte (128 bytes com 64 pontos). O custo
+ * em ciclos é medido por `benchmark.h` e limita a taxa em que todos os blocos
+ * são transformados: N amostras devem chegar em mais tempo do que uma FFT.
+ *
+ * Este módulo não depende do AVR, para ser compilado também no host, como
+ * `pipeline.h`.
+ */
+
+
+// Quantidade de pontos de cada bloco
+#ifndef FFT_POINTS
+#define FFT_POINTS 64
+#endif
+
+_Static_assert(FFT_POINTS == 64 || FFT_POINTS == 128, "a FFT deve ter 64 ou 128 pontos");
+
+// Quantidade de frequências do resultado
+#define FFT_BINS (FFT_POINTS / 2)
+
+// Deslocamento das amostras (de 10 bits, sem o nível DC) para a faixa de Q15
+#define FFT_INPUT_SHIFT 4
+
+
+// Calcula o espectro do bloco. As magnitudes são escritas nas `FFT_BINS`
+// primeiras posições do próprio bloco
+void fft_magnitudes(uint16_t block[FFT_POINTS]);
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef INTERRUPTS_H
+#define INTERRUPTS_H
+
+#include <avr/interrupt.h>
+
+/**
+ * Política de aninhamento das interrupções.
+ *
+ * O AVR não tem prioridades de interrupção configuráveis: enquanto uma rotina
+ * executa, todas as outras esperam. Para que a amostragem não sofra jitter
+ * com o trabalho das outras rotinas, só a interrupção do ADC é crítica e
+ * executa inteira com as interrupções desabilitadas. As demais reconhecem a
+ * sua fonte e reabilitam as interrupções, podendo ser interrompidas pelo ADC:
+ *
+ *     ADC_vect         crítica, nunca é interrompida
+ *     USART_RX_vect    lê UDR0 e mascara RXCIE0, depois aninha
+ *     USART_UDRE_vect  mascara UDRIE0 (UDRE é um nível), depois aninha
+ *     USART_TX_vect    não aninha (só limpa TXCIE0 e libera a USART)
+ *     TIMER1_COMPB_vect
+ *                      não aninha (curta, e programa a próxima borda da
+ *                      serial de depuração antes que ela chegue)
+ *     TIMER1_OVF_vect  não aninha (só conta a volta da base de tempo, ver
+ *                      `timebase.h`)
+ *     TWI_vect         mascara TWIE (TWINT só é limpo no fim), depois aninha
+ *     EE_READY_vect    mascara EERIE, aninha, e desabilita as interrupções
+ *                      de novo só para a sequência temporizada de escrita
+ *     WDT_vect         ISR_NOBLOCK (a flag é limpa ao atender o vetor)
+ *     PCINT2_vect      ISR_NOBLOCK (a flag é limpa ao atender o vetor)
+ *
+ * `ISR_NOBLOCK` reabilita as interrupções antes do prólogo, então só serve
+ * para fontes cuja flag é limpa pelo hardware ao atender o vetor. Nas fontes
+ * que continuam ativas enquanto a causa existir (UDRE, TWINT, EEPROM pronta),
+ * a interrupção é reabilitada com `INTERRUPT_NEST` depois de mascarar a fonte,
+ * e desabilitada com `INTERRUPT_UNNEST` antes de desmascará-la, o que também
+ * impede que a mesma rotina seja reentrada. Todas as escritas em registradores
+ * compartilhados por mais de uma rotina (UCSR0B, por exemplo) são feitas com as
+ * interrupções desabilitadas.
+ *
+ * Com isso, a latência da interrupção do ADC fica limitada pela parte de cada
+ * rotina executada antes de `INTERRUPT_NEST` (o prólogo, o reconhecimento da
+ * fonte e a máscara), em vez da rotina inteira. Ela pode ser medida no simavr
+ * com `tools/sim.c` (coluna de latência do vetor ADC). Compilando com
+ * `-DINTERRUPT_NESTING=0` (ambiente `blocking` do PlatformIO), nenhuma rotina
+ * aninha, para comparação.
+ *
+ * Uma rotina aninhada pode ser a produtora ou consumidora de uma fila SPSC
+ * (`ring.h`) e postar um evento (`scheduler.h`), desde que seja a única
+ * interrupção a fazê-lo.
+ */
+
+
+#ifndef INTERRUPT_NESTING
+#define INTERRUPT_NESTING 1
+#endif
+
+#if INTERRUPT_NESTING
+// Reabilita as interrupções em uma rotina não crítica, depois de reconhecer e
+// mascarar a sua fonte
+#define INTERRUPT_NEST() sei()
+// Desabilita as interrupções antes de desmascarar a fonte
+#define INTERRUPT_UNNEST() cli()
+// Atributo das rotinas cuja flag é limpa pelo hardware ao atender o vetor
+#define ISR_NONCRITICAL ISR_NOBLOCK
+#else
+#define INTERRUPT_NEST()
+#define INTERRUPT_UNNEST()
+#define ISR_NONCRITICAL ISR_BLOCK
+#endif
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef LINEARIZE_H
+#define LINEARIZE_H
+
+#include <stdint.h>
+
+/**
+ * Linearização de sensores não lineares por tabelas na flash (PROGMEM).
+ *
+ * Cada tabela dá o valor em unidades de engenharia em `LINEARIZE_SEGMENTS + 1`
+ * pontos igualmente espaçados da faixa do ADC (a cada 16 LSB, de 0 a 1024), e
+ * o valor entre dois pontos é interpolado linearmente. Como os pontos são
+ * igualmente espaçados, o segmento é obtido por um deslocamento, sem busca, e
+ * a interpolação é uma multiplicação de 16 por 8 bits seguida de outro
+ * deslocamento, então o custo não depende do valor nem da tabela (ver
+ * `benchmark.h`).
+ *
+ * O resultado é um inteiro com sinal de 16 bits, na unidade da tabela. Para
+ * os termistores, a unidade é o centésimo de grau Celsius (2500 é 25,00 °C),
+ * que cobre de -327,68 °C a 327,67 °C.
+ *
+ * A tabela de cada canal faz parte da configuração (`config.h`). Este módulo
+ * não depende do AVR, para ser compilado também no host, como `pipeline.h`.
+ */
+
+
+// Quantidade de segmentos de cada tabela, e a largura de cada um (em LSB)
+#define LINEARIZE_SEGMENTS 64
+#define LINEARIZE_SEGMENT_SHIFT 4
+
+// Tabelas disponíveis
+// Sem linearização: o resultado é o próprio valor do ADC
+#define LINEARIZE_NONE 0
+// Termistores NTC de 10 kΩ a 25 °C, com B de 3950 K e de 3435 K, ligados
+// entre ADC0 e o terra, com um resistor de 10 kΩ entre AREF e ADC0. O
+// resultado, em centésimos de grau Celsius, é limitado à faixa de -55 °C a
+// 150 °C, e o erro da interpolação fica abaixo de 0,3 °C entre -20 °C e 100 °C
+#define LINEARIZE_NTC_3950 1
+#define LINEARIZE_NTC_3435 2
+
+#define LINEARIZE_TABLES_NUMBER 3
+
+
+// Converte o valor `raw` do ADC pela tabela `table`. Uma tabela inexistente é
+// tratada como `LINEARIZE_NONE`
+int16_t linearize(uint8_t table, uint16_t raw);
+
+#endif
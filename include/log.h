@@ -0,0 +1,101 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <stdint.h>
+#include <util/atomic.h>
+
+#include "debug.h"
+#include "log_messages.h"
+
+/**
+ * Log binário com formatação adiada, transmitido pela serial de depuração
+ * (`debug.h`).
+ *
+ * Formatar texto no AVR custa divisões e dezenas de bytes por mensagem. Aqui,
+ * cada ponto de chamada só coloca na fila da serial de depuração um registro
+ * com o identificador da mensagem e os argumentos em binário:
+ *
+ *     0x80 | identificador    1 byte
+ *     argumentos              2 bytes cada, little-endian
+ *
+ * As mensagens, com as quantidades de argumentos e os formatos, ficam na
+ * tabela de `log_messages.h`. O firmware só compila os identificadores, e o
+ * host (`tools/decode.c`) compila a mesma tabela para formatar os registros,
+ * então os textos nunca ocupam a flash. O bit 7 do primeiro byte marca o
+ * início de cada registro, o que permite ao host se ressincronizar no meio do
+ * stream, e o tamanho do registro vem da tabela. Com um byte de
+ * identificador, cabem 128 mensagens.
+ *
+ * `LOG0(nome)`, `LOG1(nome, a)` e `LOG2(nome, a, b)` registram a mensagem
+ * `nome` com 0, 1 ou 2 argumentos, e a quantidade é conferida com a da tabela
+ * na compilação. O registro é inserido inteiro na fila, com as interrupções
+ * desabilitadas, ou descartado e contado caso não caiba, então os pontos de
+ * chamada podem estar em qualquer interrupção. Sem `-DDEBUG_UART`, as macros
+ * não geram código.
+ *
+ * O custo de um registro é o da escrita dos seus bytes na fila, sem nenhuma
+ * formatação: com a função inline e os argumentos constantes em quantidade,
+ * cerca de 40 ciclos para um registro com um argumento (estimativa da
+ * contagem das instruções, ver `benchmark.h` para a medição).
+ */
+
+
+// Marcador do primeiro byte de um registro
+#define LOG_RECORD_MARKER 0x80
+
+// Identificadores das mensagens, na ordem da tabela
+enum log_message {
+#define LOG_MESSAGE(name, arguments, format) LOG_##name,
+    LOG_MESSAGES
+#undef LOG_MESSAGE
+    LOG_MESSAGES_NUMBER
+};
+
+_Static_assert(LOG_MESSAGES_NUMBER <= 128, "no máximo 128 mensagens no log");
+
+// Quantidade de argumentos de cada mensagem
+enum log_arguments {
+#define LOG_MESSAGE(name, arguments, format) LOG_ARGUMENTS_##name = (arguments),
+    LOG_MESSAGES
+#undef LOG_MESSAGE
+};
+
+
+#ifdef DEBUG_UART
+
+#define LOG0(name) LOG_WRITE(name, 0, 0, 0)
+#define LOG1(name, a) LOG_WRITE(name, 1, a, 0)
+#define LOG2(name, a, b) LOG_WRITE(name, 2, a, b)
+
+#define LOG_WRITE(name, n, a, b)                                                \
+    do {                                                                        \
+        _Static_assert(LOG_ARGUMENTS_##name == (n),                             \
+            "quantidade de argumentos de " #name " diferente da tabela");       \
+        log_write(LOG_##name, (n), (a), (b));                                   \
+    } while (0)
+
+// Coloca um registro na fila da serial de depuração, ou o descarta caso não
+// caiba. `arguments` deve ser uma constante, para que o tamanho do registro
+// seja conhecido na compilação
+static inline void log_write(uint8_t id, uint8_t arguments, uint16_t a, uint16_t b) {
+    const uint8_t record[5] = { LOG_RECORD_MARKER | id, a, a >> 8, b, b >> 8 };
+    const uint8_t length = 1 + 2 * arguments;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        if (debug_ring_free(&debug_ring) >= length) {
+            debug_ring_push_bulk(&debug_ring, record, length);
+            debug_kick();
+        } else {
+            debug_stats.records_dropped += 1;
+        }
+    }
+}
+
+#else
+
+#define LOG0(name) ((void) 0)
+#define LOG1(name, a) ((void) 0)
+#define LOG2(name, a, b) ((void) 0)
+
+#endif
+
+#endif
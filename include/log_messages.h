@@ -0,0 +1,32 @@
+#ifndef LOG_MESSAGES_H
+#define LOG_MESSAGES_H
+
+/**
+ * Tabela das mensagens do log binário (ver `log.h`).
+ *
+ * Cada entrada é `LOG_MESSAGE(nome, argumentos, formato)`. O identificador de
+ * cada mensagem é a sua posição na tabela, então novas mensagens devem ser
+ * acrescentadas no final, para que logs antigos continuem decodificáveis. Os
+ * argumentos são valores de 16 bits, e o formato é aplicado a eles, em ordem,
+ * pelo host (`tools/decode.c`), com as conversões:
+ *
+ *     %u  decimal sem sinal
+ *     %d  decimal com sinal
+ *     %x  hexadecimal
+ *     %c  caractere (byte baixo)
+ *     %%  o próprio '%'
+ *
+ * Este arquivo só contém macros, e também é incluído pelo host. O firmware
+ * utiliza só os nomes e as quantidades de argumentos: os formatos não são
+ * compilados nele.
+ */
+
+
+#define LOG_MESSAGES                                                            \
+    LOG_MESSAGE(BOOT_READY, 1, "boot_ready %u")                                 \
+    LOG_MESSAGE(COMMAND, 2, "command %c %u")                                    \
+    LOG_MESSAGE(RATE_CHANGE, 2, "rate %u -> %u")                                \
+    LOG_MESSAGE(SAMPLE_DROPPED, 2, "sample_dropped sequence=%u value=%u")       \
+    LOG_MESSAGE(BLOCK_DROPPED, 1, "block_dropped total=%u")
+
+#endif
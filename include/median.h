@@ -0,0 +1,49 @@
+#ifndef MEDIAN_H
+#define MEDIAN_H
+
+#include <stdint.h>
+
+/**
+ * Filtro de mediana móvel, para remover picos isolados (de uma amostra, ou
+ * de até (n - 1) / 2 amostras seguidas com uma janela de n) sem espalhá-los
+ * como um filtro linear faria.
+ *
+ * Além do histórico circular das últimas amostras, a janela é mantida
+ * ordenada. A cada amostra, a mais antiga é retirada e a nova é inserida em
+ * uma única passada pela janela ordenada, deslocando os valores entre as duas
+ * posições, então o custo é O(n) e não há ordenação completa. A mediana é o
+ * elemento do meio.
+ *
+ * A saída fica atrasada (n - 1) / 2 amostras em relação à entrada. Enquanto a
+ * janela não está cheia, a mediana é a das amostras recebidas até então.
+ *
+ * Este módulo não depende do AVR, para ser compilado também no host, como
+ * `pipeline.h`.
+ */
+
+
+// Maior janela (ímpar)
+#define MEDIAN_WINDOW_MAX 9
+
+
+// Estado do filtro de um canal
+struct median {
+    // Tamanho da janela (ímpar, 1 desliga o filtro)
+    uint8_t size;
+    // Quantidade de amostras na janela, e a posição da mais antiga no
+    // histórico
+    uint8_t count;
+    uint8_t oldest;
+    uint16_t history[MEDIAN_WINDOW_MAX];
+    uint16_t sorted[MEDIAN_WINDOW_MAX];
+};
+
+
+// Esvazia a janela e muda o seu tamanho. Um tamanho par ou maior que
+// `MEDIAN_WINDOW_MAX` é recusado, e a função retorna 0
+uint8_t median_reset(struct median *median, uint8_t size);
+
+// Adiciona uma amostra e retorna a mediana da janela
+uint16_t median_filter(struct median *median, uint16_t sample);
+
+#endif
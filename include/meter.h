@@ -0,0 +1,102 @@
+#ifndef METER_H
+#define METER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Medidor de energia de uma carga AC, a partir das amostras alternadas de
+ * tensão e corrente.
+ *
+ * As duas entradas são amostradas pelo mesmo ADC, uma de cada vez, então cada
+ * amostra de corrente é tomada um período de amostragem depois da tensão
+ * anterior e um antes da seguinte. Para corrigir essa defasagem, a corrente é
+ * combinada com a média das duas tensões vizinhas, a tensão interpolada no
+ * instante da corrente. A interpolação linear atenua a componente da rede
+ * por cos(2π f / taxa) (1,2% a 50 Hz e 2 kHz, 0,5% a 3 kHz, a taxa máxima),
+ * o que é compensado na potência para a frequência `METER_LINE_FREQUENCY`. As
+ * harmônicas ficam com um erro um pouco maior. Abaixo de `METER_RATE_MIN`, a
+ * correção não é aplicada: a aproximação deixa de valer, e a taxa de cada
+ * entrada fica perto da frequência da rede (abaixo de Nyquist na taxa padrão
+ * de 125 Hz), então as medidas não são confiáveis de qualquer forma. A tensão eficaz é calculada com
+ * as amostras originais, sem interpolação.
+ *
+ * Em cada janela (um segundo) são acumuladas as somas das amostras, dos seus
+ * quadrados e dos produtos tensão vezes corrente, em inteiros de 32 e 64 bits.
+ * No fim da janela, o nível DC de cada entrada (o ponto médio do divisor) é
+ * removido pela própria média da janela:
+ *
+ *     Vrms² = média(v²) - média(v)²
+ *     P = média(v * i) - média(v) * média(i)
+ *
+ * e o resultado é convertido para unidades físicas pelos fatores de escala
+ * abaixo. A energia é acumulada em 64 bits (µJ) enquanto o medidor estiver
+ * ligado, mesmo entre janelas com taxas de amostragem diferentes.
+ *
+ * Este módulo não depende do AVR, para ser compilado também no host, como
+ * `pipeline.h`.
+ */
+
+
+// Entradas do medidor, na ordem em que são amostradas
+#define METER_VOLTAGE 0
+#define METER_CURRENT 1
+
+// Fatores de escala das entradas, em mV e mA da carga por LSB do ADC, em
+// ponto fixo com 8 bits fracionários. Os padrões correspondem a 230 V e 10 A
+// eficazes ocupando cerca de ±500 LSB em torno do ponto médio
+#ifndef METER_VOLTAGE_SCALE
+#define METER_VOLTAGE_SCALE (650ul * 256)
+#endif
+#ifndef METER_CURRENT_SCALE
+#define METER_CURRENT_SCALE (28ul * 256)
+#endif
+
+// Frequência da rede (em Hz), para a correção da interpolação
+#ifndef METER_LINE_FREQUENCY
+#define METER_LINE_FREQUENCY 50
+#endif
+
+// Correção do ganho da interpolação, 1/cos(x) ≈ 1 + x²/2 com x = 2π f / taxa,
+// com 16 bits fracionários: o termo x²/2 é esta constante dividida pela taxa
+// ao quadrado. A aproximação vale para taxas bem maiores que a frequência da
+// rede (a 50 Hz, erro de 0,3% a 1 kHz e abaixo de 0,02% acima de 2 kHz)
+#define METER_GAIN_CORRECTION \
+    ((uint64_t) (2 * 3.14159265 * 3.14159265 * METER_LINE_FREQUENCY * METER_LINE_FREQUENCY * 65536))
+
+// Menor taxa de amostragem (em Hz, contando as duas entradas) em que a
+// correção do ganho é aplicada
+#define METER_RATE_MIN 1000
+
+// Quantidade máxima de bytes de um registro formatado
+#define METER_RECORD_MAX 49
+
+
+// Resultado de uma janela
+struct meter_record {
+    // Tensão e corrente eficazes (mV e mA)
+    uint32_t voltage_rms;
+    uint32_t current_rms;
+    // Potência ativa média (mW), negativa quando a carga fornece energia
+    int32_t power;
+    // Energia acumulada desde que o medidor foi ligado (mWh)
+    int32_t energy;
+};
+
+
+// Zera a energia acumulada e recomeça a janela, para a taxa de amostragem
+// `rate` (em Hz, contando as duas entradas)
+void meter_reset(uint16_t rate);
+
+// Recomeça a janela após uma mudança da taxa de amostragem, mantendo a energia
+void meter_set_rate(uint16_t rate);
+
+// Adiciona uma amostra da entrada `input`. Retorna verdadeiro quando a janela
+// termina, escrevendo o seu resultado em `record`
+bool meter_add(uint8_t input, uint16_t sample, struct meter_record *record);
+
+// Formata um registro como a linha "tensão,corrente,potência,energia\r\n".
+// Retorna a quantidade de bytes escritos
+uint8_t meter_format(const struct meter_record *record, uint8_t out[METER_RECORD_MAX]);
+
+#endif
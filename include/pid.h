@@ -0,0 +1,50 @@
+#ifndef PID_H
+#define PID_H
+
+#include <stdint.h>
+
+/**
+ * Controlador PID em ponto fixo, executado a cada amostra.
+ *
+ * Os ganhos são números Q8.8 (256 corresponde a 1,0), em unidades da saída
+ * por LSB do ADC: com `kp = 256`, um erro de 1 LSB muda a saída em 1. `ki` e
+ * `kd` são por amostra, então o seu efeito em tempo depende da taxa de
+ * amostragem. A saída vai de 0 a 255 (o duty cycle do PWM).
+ *
+ * O termo derivativo é calculado sobre a medida, e não sobre o erro, para que
+ * uma mudança do setpoint não cause um pico na saída. O anti-windup limita o
+ * termo integral à faixa da saída, então depois de uma saturação longa o
+ * controlador volta a responder assim que o erro muda de sinal.
+ *
+ * Todos os produtos são de 16 por 16 bits, com resultado de 32 bits, sem
+ * divisões: um erro de até ±1023 vezes um ganho de até 32767 não transborda.
+ * O módulo não depende do AVR, para ser testado no host como `pipeline.h`.
+ */
+
+
+// Faixa da saída
+#define PID_OUTPUT_MIN 0
+#define PID_OUTPUT_MAX 255
+
+
+struct pid {
+    // Setpoint, na escala do ADC
+    uint16_t setpoint;
+    // Ganhos Q8.8
+    int16_t kp;
+    int16_t ki;
+    int16_t kd;
+    // Termo integral (Q8.8 da saída) e a medida anterior
+    int32_t integral;
+    uint16_t last_measurement;
+};
+
+
+// Reinicia o estado do controlador, sem alterar o setpoint e os ganhos. A
+// saída começa em `output`, para que a transição seja suave
+void pid_reset(struct pid *pid, uint16_t measurement, uint8_t output);
+
+// Calcula a saída para uma nova medida
+uint8_t pid_update(struct pid *pid, uint16_t measurement);
+
+#endif
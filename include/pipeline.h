@@ -0,0 +1,56 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdint.h>
+
+/**
+ * Processamento de cada amostra no contexto principal, do valor lido pelo ADC
+ * até os bytes transmitidos pela serial.
+ *
+ * Este módulo não depende do AVR (nenhum registrador, interrupção ou
+ * cabeçalho `avr/`), para que seja compilado também no host, pelo
+ * `tools/replay.c`, e exercitado com traços gravados muito mais rápido que em
+ * tempo real. Filtros, conversões e detectores aplicados às amostras devem
+ * ficar aqui pelo mesmo motivo, deixando em `main.c` apenas a ligação com os
+ * periféricos.
+ */
+
+
+// Quantidade máxima de bytes produzidos por uma amostra
+#define PIPELINE_OUTPUT_MAX 6
+
+// Quantidade máxima de bytes de uma linha de telemetria do controle
+#define PIPELINE_TELEMETRY_MAX 15
+
+// Quantidade de bytes de uma linha com um valor em unidades de engenharia
+#define PIPELINE_UNITS_MAX 8
+
+// Quantidade de amostras em cada estimativa da atividade do sinal
+#define PIPELINE_ACTIVITY_WINDOW 32
+
+
+// Processa uma amostra, escrevendo em `out` os bytes a transmitir (a linha
+// "dddd\r\n"). Retorna a quantidade de bytes escritos
+uint8_t pipeline_process(uint16_t sample, uint8_t out[PIPELINE_OUTPUT_MAX]);
+
+// Formata uma linha com um valor linearizado (ver `linearize.h`), com sinal
+// e cinco dígitos, "+ddddd\r\n". Retorna a quantidade de bytes escritos
+uint8_t pipeline_units(int16_t value, uint8_t out[PIPELINE_UNITS_MAX]);
+
+// Formata uma linha de telemetria do controle, "ssss,mmmm,ooo\r\n", com o
+// setpoint, a medida e a saída. Retorna a quantidade de bytes escritos
+uint8_t pipeline_telemetry(
+    uint16_t setpoint, uint16_t measurement, uint8_t output,
+    uint8_t out[PIPELINE_TELEMETRY_MAX]
+);
+
+// Estima a atividade do sinal pela média da variação absoluta entre amostras
+// consecutivas, a cada `PIPELINE_ACTIVITY_WINDOW` amostras. Ao fim de cada
+// janela, retorna 1 caso a média passe de `high` (a taxa deve subir), -1 caso
+// fique abaixo de `low` (a taxa deve descer), e 0 nos demais casos
+int8_t pipeline_activity(uint16_t sample, uint8_t high, uint8_t low);
+
+// Descarta a janela atual da estimativa, após uma mudança de taxa
+void pipeline_activity_reset(void);
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef POWER_H
+#define POWER_H
+
+#include <stdint.h>
+
+/**
+ * Gerenciador de energia.
+ *
+ * Cada parte do programa informa com `power_require` quais periféricos
+ * precisam continuar funcionando enquanto a CPU dorme, e os libera com
+ * `power_release`. A cada vez que o escalonador não tem eventos pendentes,
+ * `power_sleep` escolhe o modo de sono mais profundo compatível com esses
+ * periféricos:
+ *
+ * - idle: o clock de I/O continua ativo (timers e USART funcionam);
+ * - power-down: nada continua ativo. A CPU acorda pela mudança de nível no
+ *   pino RXD (PCINT16), então o primeiro byte recebido pode ser perdido caso o
+ *   oscilador não se estabilize a tempo, e o host deve repeti-lo se não
+ *   houver resposta.
+ *
+ * Os modos ADC noise reduction e power-save não são utilizados: as conversões
+ * do ADC são disparadas pelo Timer0, que para nesses modos, e o Timer2 só é
+ * usado no clock de I/O, para o PWM do controle.
+ *
+ * Os módulos que o programa não utiliza (TWI, SPI e Timer2) são desligados
+ * pelo PRR em `power_init`, assim como o comparador analógico e os buffers
+ * digitais das entradas analógicas. Um módulo utilizado depois é religado
+ * pelo seu próprio código (o TWI em `twi_init` e o Timer2 enquanto o controle
+ * está ligado, por exemplo).
+ *
+ * O tempo em idle é medido em ciclos pela base de tempo (Timer1). Em
+ * power-down o Timer1 para, então o tempo é contado pelo watchdog, que é
+ * habilitado em modo de interrupção com período de 128 ms enquanto a CPU
+ * dorme. Um sono interrompido por outra fonte (o pino RXD) conta meio
+ * período, então o erro de cada sono é de no máximo 64 ms, e não se acumula
+ * em uma direção. Com esses tempos e as correntes de cada estado (datasheet
+ * ou medição), a energia por amostra é
+ *
+ *     E = Vcc * (I_ativo * t_ativo + sum(I_modo * t_modo)) / amostras
+ */
+
+
+// Periféricos que podem ser requisitados durante o sono
+#define POWER_TIMER0 (1<<0)
+#define POWER_TIMER1 (1<<1)
+#define POWER_USART (1<<2)
+// Transmissão em andamento pela USART (até o último byte sair do shift register)
+#define POWER_USART_TX (1<<5)
+// Transação em andamento no TWI (o reconhecimento do endereço funciona em
+// qualquer modo, mas a transferência dos dados precisa do clock de I/O)
+#define POWER_TWI (1<<6)
+// Timer2 no clock de I/O (PWM da saída do controle)
+#define POWER_TIMER2 (1<<7)
+
+// Modos de sono, do mais raso para o mais profundo
+#define POWER_MODE_IDLE 0
+#define POWER_MODE_DOWN 1
+
+#define POWER_MODES_NUMBER 2
+
+
+// Estatísticas do gerenciador de energia
+struct power_stats {
+    // Quantidade de vezes que cada modo foi utilizado
+    uint32_t entries[POWER_MODES_NUMBER];
+    // Ciclos dormindo em idle
+    uint32_t idle_cycles;
+    // Milissegundos dormindo em power-down
+    uint32_t down_milliseconds;
+};
+
+extern struct power_stats power_stats;
+
+
+// Desliga os módulos que não são utilizados. `analog_inputs` indica os pinos
+// da porta C utilizados como entradas analógicas
+void power_init(uint8_t analog_inputs);
+
+// Requisita/libera periféricos que precisam continuar ativos durante o sono
+void power_require(uint8_t peripherals);
+void power_release(uint8_t peripherals);
+
+// Copia as estatísticas para `stats` e as zera
+void power_read_stats(struct power_stats *stats);
+
+// Dorme no modo mais profundo permitido até a próxima interrupção. Deve ser
+// chamada com as interrupções desabilitadas, e retorna com elas habilitadas
+void power_sleep(void);
+
+#endif
@@ -0,0 +1,238 @@
+#ifndef REG_H
+#define REG_H
+
+#include <stdint.h>
+
+/**
+ * Configuração de registradores por campos nomeados, resolvida em tempo de
+ * compilação.
+ *
+ * Cada campo é descrito por uma macro `<REGISTRADOR>_<CAMPO>` que expande para
+ * o deslocamento e a largura do campo (por exemplo, `ADCSRA_ADPS` é `0, 3`).
+ * `REG_FIELD(campo, valor)` cria um par (máscara, valor deslocado), e
+ * `REG_CONFIG(registrador, campos...)` combina até 8 pares em um único valor
+ * de 8 bits:
+ *
+ *     ADCSRA = REG_CONFIG(ADCSRA,
+ *         REG_FIELD(ADCSRA_ADEN, 1),
+ *         REG_FIELD(ADCSRA_ADPS, ADC_PRESCALER_16));
+ *
+ * O resultado é uma expressão constante, então a escrita no registrador gera
+ * exatamente o mesmo código que o literal equivalente (`ldi` e `out`/`sts`), e
+ * pode ser usada dentro de interrupções e na inicialização. A compilação falha
+ * caso:
+ *
+ * - um valor não caiba na largura do seu campo;
+ * - dois campos se sobreponham (o mesmo campo repetido, por exemplo), o que é
+ *   verificado comparando a soma das máscaras com o OU delas;
+ * - algum campo ocupe um bit reservado ou somente de leitura, dados pela
+ *   macro `<REGISTRADOR>_RESERVED`.
+ *
+ * Campos não mencionados ficam em 0.
+ */
+
+
+// Verificação em tempo de compilação dentro de uma expressão (vale 0)
+#define REG_CHECK(condition, message) \
+    (0 * sizeof(struct { _Static_assert(condition, message); char c; }))
+
+// Par (máscara, valor deslocado) de um campo, verificando a largura do valor
+#define REG_FIELD(field, value) REG_FIELD_(field, value)
+#define REG_FIELD_(shift, width, value) (                                       \
+    REG_CHECK((unsigned long) (value) < (1ul << (width)),                       \
+        "valor maior que a largura do campo: " #value)                         \
+        + (((1u << (width)) - 1) << (shift)),                                   \
+    (unsigned) (value) << (shift)                                               \
+)
+
+#define REG_MASK_(mask, value) (mask)
+#define REG_VALUE_(mask, value) (value)
+#define REG_PLUS_MASK(field) + REG_MASK_ field
+#define REG_OR_MASK(field) | REG_MASK_ field
+#define REG_OR_VALUE(field) | REG_VALUE_ field
+
+// Aplica `macro` a cada um dos argumentos (até 8)
+#define REG_FOR_EACH(macro, ...) \
+    REG_FOR_EACH_N(__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, _)(macro, __VA_ARGS__)
+#define REG_FOR_EACH_N(_1, _2, _3, _4, _5, _6, _7, _8, n, ...) REG_FOR_EACH_##n
+#define REG_FOR_EACH_1(m, a) m(a)
+#define REG_FOR_EACH_2(m, a, ...) m(a) REG_FOR_EACH_1(m, __VA_ARGS__)
+#define REG_FOR_EACH_3(m, a, ...) m(a) REG_FOR_EACH_2(m, __VA_ARGS__)
+#define REG_FOR_EACH_4(m, a, ...) m(a) REG_FOR_EACH_3(m, __VA_ARGS__)
+#define REG_FOR_EACH_5(m, a, ...) m(a) REG_FOR_EACH_4(m, __VA_ARGS__)
+#define REG_FOR_EACH_6(m, a, ...) m(a) REG_FOR_EACH_5(m, __VA_ARGS__)
+#define REG_FOR_EACH_7(m, a, ...) m(a) REG_FOR_EACH_6(m, __VA_ARGS__)
+#define REG_FOR_EACH_8(m, a, ...) m(a) REG_FOR_EACH_7(m, __VA_ARGS__)
+
+// Valor de 8 bits do registrador `reg` com os campos dados
+#define REG_CONFIG(reg, ...) ((uint8_t) (                                       \
+    REG_CHECK(                                                                  \
+        (0 REG_FOR_EACH(REG_PLUS_MASK, __VA_ARGS__))                            \
+            == (0 REG_FOR_EACH(REG_OR_MASK, __VA_ARGS__)),                      \
+        "campos sobrepostos em " #reg)                                          \
+    + REG_CHECK(                                                                \
+        ((0 REG_FOR_EACH(REG_OR_MASK, __VA_ARGS__)) & reg##_RESERVED) == 0,     \
+        "bit reservado ou somente de leitura em " #reg)                         \
+    + (0 REG_FOR_EACH(REG_OR_VALUE, __VA_ARGS__))                               \
+))
+
+
+// ADC Multiplexer Selection Register
+#define ADMUX_RESERVED 0b00010000
+#define ADMUX_REFS 6, 2
+#define ADMUX_ADLAR 5, 1
+#define ADMUX_MUX 0, 4
+
+// Tensões de referência do ADC
+#define ADC_REFERENCE_AREF 0
+#define ADC_REFERENCE_AVCC 1
+#define ADC_REFERENCE_INTERNAL 3
+
+// ADC Control and Status Register A
+#define ADCSRA_RESERVED 0b00000000
+#define ADCSRA_ADEN 7, 1
+#define ADCSRA_ADSC 6, 1
+#define ADCSRA_ADATE 5, 1
+#define ADCSRA_ADIF 4, 1
+#define ADCSRA_ADIE 3, 1
+#define ADCSRA_ADPS 0, 3
+
+// Prescalers do clock do ADC
+#define ADC_PRESCALER_2 1
+#define ADC_PRESCALER_4 2
+#define ADC_PRESCALER_8 3
+#define ADC_PRESCALER_16 4
+#define ADC_PRESCALER_32 5
+#define ADC_PRESCALER_64 6
+#define ADC_PRESCALER_128 7
+
+// ADC Control and Status Register B
+#define ADCSRB_RESERVED 0b10111000
+#define ADCSRB_ACME 6, 1
+#define ADCSRB_ADTS 0, 3
+
+// Fontes do auto-trigger do ADC
+#define ADC_TRIGGER_FREE_RUNNING 0
+#define ADC_TRIGGER_TIMER0_COMPA 3
+#define ADC_TRIGGER_TIMER1_COMPB 5
+
+
+// Timer/Counter 0 Control Register A
+#define TCCR0A_RESERVED 0b00001100
+#define TCCR0A_COM0A 6, 2
+#define TCCR0A_COM0B 4, 2
+#define TCCR0A_WGM 0, 2
+
+// Timer/Counter 0 Control Register B (WGM02 é o bit mais alto do modo)
+#define TCCR0B_RESERVED 0b00110000
+#define TCCR0B_FOC0A 7, 1
+#define TCCR0B_FOC0B 6, 1
+#define TCCR0B_WGM02 3, 1
+#define TCCR0B_CS 0, 3
+
+// Modos do Timer0 (bits WGM01:00)
+#define TIMER0_WGM_NORMAL 0
+#define TIMER0_WGM_CTC 2
+
+// Timer/counter 0 Interrupt MaSK register
+#define TIMSK0_RESERVED 0b11111000
+#define TIMSK0_OCIE0B 2, 1
+#define TIMSK0_OCIE0A 1, 1
+#define TIMSK0_TOIE0 0, 1
+
+// Timer/Counter 1 Control Register A
+#define TCCR1A_RESERVED 0b00001100
+#define TCCR1A_COM1A 6, 2
+#define TCCR1A_COM1B 4, 2
+#define TCCR1A_WGM 0, 2
+
+// Timer/Counter 1 Control Register B (bits WGM13:12 do modo)
+#define TCCR1B_RESERVED 0b00100000
+#define TCCR1B_ICNC1 7, 1
+#define TCCR1B_ICES1 6, 1
+#define TCCR1B_WGM 3, 2
+#define TCCR1B_CS 0, 3
+
+// Seleção de clock dos timers 0 e 1 (bits CSn2:0)
+#define TIMER_CLOCK_STOPPED 0
+#define TIMER_CLOCK_1 1
+#define TIMER_CLOCK_8 2
+#define TIMER_CLOCK_64 3
+#define TIMER_CLOCK_256 4
+#define TIMER_CLOCK_1024 5
+
+// Timer/Counter 2 Control Register A
+#define TCCR2A_RESERVED 0b00001100
+#define TCCR2A_COM2A 6, 2
+#define TCCR2A_COM2B 4, 2
+#define TCCR2A_WGM 0, 2
+
+// Timer/Counter 2 Control Register B (WGM22 é o bit mais alto do modo)
+#define TCCR2B_RESERVED 0b00110000
+#define TCCR2B_FOC2A 7, 1
+#define TCCR2B_FOC2B 6, 1
+#define TCCR2B_WGM22 3, 1
+#define TCCR2B_CS 0, 3
+
+// Modos do Timer2 (bits WGM21:20)
+#define TIMER2_WGM_FAST_PWM 3
+
+// Modos das saídas de compare match (bits COMnx1:0). Em PWM, CLEAR é o modo
+// não invertido; nos modos normal e CTC, o pino é zerado (CLEAR) ou setado
+// (SET) no compare match
+#define TIMER_COM_DISCONNECTED 0
+#define TIMER_COM_CLEAR 2
+#define TIMER_COM_SET 3
+
+// Seleção de clock do Timer2 (bits CS22:0, diferentes dos timers 0 e 1)
+#define TIMER2_CLOCK_STOPPED 0
+#define TIMER2_CLOCK_1 1
+
+
+// USART Control and Status Register 0 A (RXC0, UDRE0, FE0, DOR0 e UPE0 são
+// somente de leitura e devem ser escritos como 0)
+#define UCSR0A_RESERVED 0b10111100
+#define UCSR0A_TXC0 6, 1
+#define UCSR0A_U2X0 1, 1
+#define UCSR0A_MPCM0 0, 1
+
+// USART Control and Status Register 0 B (RXB80 é somente de leitura)
+#define UCSR0B_RESERVED 0b00000010
+#define UCSR0B_RXCIE0 7, 1
+#define UCSR0B_TXCIE0 6, 1
+#define UCSR0B_UDRIE0 5, 1
+#define UCSR0B_RXEN0 4, 1
+#define UCSR0B_TXEN0 3, 1
+#define UCSR0B_UCSZ02 2, 1
+#define UCSR0B_TXB80 0, 1
+
+// USART Control and Status Register 0 C (UCSZ01:00 são os bits baixos do
+// tamanho do frame, completados por UCSZ02 em UCSR0B)
+#define UCSR0C_RESERVED 0b00000000
+#define UCSR0C_UMSEL0 6, 2
+#define UCSR0C_UPM0 4, 2
+#define UCSR0C_USBS0 3, 1
+#define UCSR0C_UCSZ0 1, 2
+#define UCSR0C_UCPOL0 0, 1
+
+// Modos da USART e tamanhos de frame (bits UCSZ01:00)
+#define USART_MODE_ASYNC 0
+#define USART_PARITY_NONE 0
+#define USART_CHARACTER_8 3
+
+
+// TWI Control Register (TWWC é somente de leitura)
+#define TWCR_RESERVED 0b00001010
+#define TWCR_TWINT 7, 1
+#define TWCR_TWEA 6, 1
+#define TWCR_TWSTA 5, 1
+#define TWCR_TWSTO 4, 1
+#define TWCR_TWEN 2, 1
+#define TWCR_TWIE 0, 1
+
+// TWI (Slave) Address Register
+#define TWAR_RESERVED 0b00000000
+#define TWAR_TWA 1, 7
+#define TWAR_TWGCE 0, 1
+
+#endif
@@ -0,0 +1,132 @@
+#ifndef RING_H
+#define RING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Fila circular sem travas para um produtor e um consumidor (SPSC), utilizada
+ * na passagem de dados entre as interrupções e o contexto principal.
+ *
+ * `RING_DEFINE(nome, tipo, capacidade)` define o tipo `struct nome` e as
+ * funções `nome_push`, `nome_pop`, `nome_peek`, `nome_push_bulk`,
+ * `nome_pop_bulk`, `nome_count` e `nome_free`, todas `static inline`, como um template para o
+ * tipo dos elementos e a capacidade.
+ *
+ * Os índices `head` e `tail` têm 8 bits e avançam livremente, dando a volta em
+ * 256. A posição no buffer é obtida com uma máscara, por isso a capacidade
+ * deve ser uma potência de 2, e a quantidade de elementos é `head - tail`
+ * (módulo 256), por isso a capacidade deve ser no máximo 128. Cada índice é
+ * escrito por apenas um dos lados (`head` pelo produtor e `tail` pelo
+ * consumidor), e a leitura ou escrita de um byte é atômica no AVR, então não
+ * é necessário desabilitar interrupções. Barreiras de compilação garantem que
+ * o produtor escreve o elemento antes de publicar o `head`, e que o consumidor
+ * só lê o elemento depois de ler o `head` (o buffer não é volatile, então sem
+ * a barreira a leitura poderia ser antecipada para antes da verificação).
+ *
+ * Se o produtor ou o consumidor estiver em uma interrupção que pode ser
+ * interrompida (ISR_NOBLOCK), nenhuma outra interrupção pode ser produtora ou
+ * consumidora da mesma fila.
+ */
+
+
+// Impede que o compilador reordene acessos à memória através deste ponto
+#define RING_BARRIER() __asm__ __volatile__ ("" ::: "memory")
+
+#define RING_DEFINE(name, type, capacity)                                       \
+    _Static_assert(                                                             \
+        (capacity) > 0 && (capacity) <= 128                                     \
+            && ((capacity) & ((capacity) - 1)) == 0,                            \
+        "a capacidade de " #name " deve ser uma potência de 2 até 128");        \
+                                                                                \
+    struct name {                                                               \
+        volatile uint8_t head;                                                  \
+        volatile uint8_t tail;                                                  \
+        type buffer[capacity];                                                  \
+    };                                                                          \
+                                                                                \
+    /* Quantidade de elementos na fila */                                       \
+    static inline uint8_t name##_count(const struct name *ring) {              \
+        return (uint8_t) (ring->head - ring->tail);                             \
+    }                                                                           \
+                                                                                \
+    /* Quantidade de posições livres na fila */                                 \
+    static inline uint8_t name##_free(const struct name *ring) {               \
+        return (capacity) - name##_count(ring);                                 \
+    }                                                                           \
+                                                                                \
+    /* Insere um elemento. Retorna falso caso a fila esteja cheia */            \
+    static inline bool name##_push(struct name *ring, type value) {            \
+        uint8_t head = ring->head;                                              \
+        if ((uint8_t) (head - ring->tail) == (capacity)) {                      \
+            return false;                                                       \
+        }                                                                       \
+        ring->buffer[head & ((capacity) - 1)] = value;                          \
+        RING_BARRIER();                                                         \
+        ring->head = head + 1;                                                  \
+        return true;                                                            \
+    }                                                                           \
+                                                                                \
+    /* Remove um elemento. Retorna falso caso a fila esteja vazia */            \
+    static inline bool name##_pop(struct name *ring, type *value) {            \
+        uint8_t tail = ring->tail;                                              \
+        if (ring->head == tail) {                                               \
+            return false;                                                       \
+        }                                                                       \
+        RING_BARRIER();                                                         \
+        *value = ring->buffer[tail & ((capacity) - 1)];                         \
+        RING_BARRIER();                                                         \
+        ring->tail = tail + 1;                                                  \
+        return true;                                                            \
+    }                                                                           \
+                                                                                \
+    /* Lê o próximo elemento sem removê-lo. Retorna falso caso a fila esteja */ \
+    /* vazia */                                                                 \
+    static inline bool name##_peek(const struct name *ring, type *value) {     \
+        uint8_t tail = ring->tail;                                              \
+        if (ring->head == tail) {                                               \
+            return false;                                                       \
+        }                                                                       \
+        RING_BARRIER();                                                         \
+        *value = ring->buffer[tail & ((capacity) - 1)];                         \
+        return true;                                                            \
+    }                                                                           \
+                                                                                \
+    /* Insere até `n` elementos, publicando todos de uma vez. Retorna a */      \
+    /* quantidade inserida */                                                   \
+    static inline uint8_t name##_push_bulk(                                     \
+        struct name *ring, const type *values, uint8_t n                        \
+    ) {                                                                         \
+        uint8_t head = ring->head;                                              \
+        uint8_t available = (capacity) - (uint8_t) (head - ring->tail);         \
+        if (n > available) {                                                    \
+            n = available;                                                      \
+        }                                                                       \
+        for (uint8_t i = 0; i < n; ++i) {                                       \
+            ring->buffer[(uint8_t) (head + i) & ((capacity) - 1)] = values[i];  \
+        }                                                                       \
+        RING_BARRIER();                                                         \
+        ring->head = head + n;                                                  \
+        return n;                                                               \
+    }                                                                           \
+                                                                                \
+    /* Remove até `n` elementos, liberando todos de uma vez. Retorna a */       \
+    /* quantidade removida */                                                   \
+    static inline uint8_t name##_pop_bulk(                                      \
+        struct name *ring, type *values, uint8_t n                              \
+    ) {                                                                         \
+        uint8_t tail = ring->tail;                                              \
+        uint8_t count = (uint8_t) (ring->head - tail);                          \
+        if (n > count) {                                                        \
+            n = count;                                                          \
+        }                                                                       \
+        RING_BARRIER();                                                         \
+        for (uint8_t i = 0; i < n; ++i) {                                       \
+            values[i] = ring->buffer[(uint8_t) (tail + i) & ((capacity) - 1)];  \
+        }                                                                       \
+        RING_BARRIER();                                                         \
+        ring->tail = tail + n;                                                  \
+        return n;                                                               \
+    }
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <avr/io.h>
+#include <stdint.h>
+
+#include "timebase.h"
+
+/**
+ * Escalonador cooperativo, do tipo run-to-completion.
+ *
+ * As interrupções apenas postam eventos com `scheduler_post`, e o trabalho
+ * correspondente é feito pelos tratadores no contexto principal, dentro de
+ * `scheduler_run`. Os eventos pendentes ficam em GPIOR0, um por bit, e por isso
+ * podem ser postados com uma única instrução `sbi`. Eventos do mesmo tipo
+ * postados antes de serem tratados são agrupados em um só, então cada tratador
+ * deve consumir todo o trabalho disponível. Quando não há eventos pendentes, a
+ * CPU dorme até a próxima interrupção, no modo escolhido pelo gerenciador de
+ * energia (`power.h`).
+ *
+ * Para cada tipo de evento é registrada a maior latência, em ciclos, entre a
+ * postagem e o início do tratador. Também são contados os ciclos em que a CPU
+ * ficou dormindo e os ciclos em que ficou ocupada. Todos os intervalos são
+ * medidos em 32 bits (`timebase_now32`), pois podem passar de uma volta do
+ * Timer1 (atrás da FFT, por exemplo). O tempo das interrupções
+ * entra na contagem do estado em que a CPU estava quando elas ocorreram. Nos
+ * modos de sono em que o Timer1 para, o tempo dormindo é contado pelo
+ * gerenciador de energia.
+ */
+
+
+// Eventos pendentes, um por bit
+#define EVENTS GPIOR0
+
+// Tipos de eventos, em ordem de prioridade (o de menor número é tratado primeiro)
+#define EVENT_COMMAND 0
+#define EVENT_SAMPLE 1
+#define EVENT_TWI 2
+// Bloco completo para o espectro. Tem a menor prioridade, pois a FFT é longa
+#define EVENT_BLOCK 3
+// Fim de um período do histograma
+#define EVENT_HISTOGRAM 4
+
+#define EVENTS_NUMBER 5
+
+
+// Função que trata um tipo de evento
+typedef void (*event_handler_t)(void);
+
+// Estatísticas do escalonador
+struct scheduler_stats {
+    // Maior latência de cada tipo de evento (em ciclos, saturada em 65535)
+    uint16_t max_latency[EVENTS_NUMBER];
+    // Ciclos dormindo e ciclos ocupados desde a última leitura
+    uint32_t idle_cycles;
+    uint32_t busy_cycles;
+};
+
+extern struct scheduler_stats scheduler_stats;
+
+// Momento em que cada evento pendente foi postado
+extern volatile uint32_t event_post_time[EVENTS_NUMBER];
+
+
+// Posta um evento. Deve ser chamada dentro de uma interrupção, com as
+// interrupções desabilitadas ou aninhada, desde que seja a única a postar
+// esse evento (ver `interrupts.h`). `event` deve ser uma constante, para que o
+// acesso a GPIOR0 seja feito com `sbic`/`sbi`
+static inline void scheduler_post(uint8_t event) {
+    if ((EVENTS & 1<<event) == 0) {
+        event_post_time[event] = timebase_now32();
+        EVENTS |= 1<<event;
+    }
+}
+
+// Trata os eventos para sempre, dormindo quando não há nenhum pendente
+void scheduler_run(const event_handler_t handlers[EVENTS_NUMBER]) __attribute__((noreturn));
+
+// Copia as estatísticas para `stats` e zera as contagens de ciclos
+void scheduler_read_stats(struct scheduler_stats *stats);
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef TIMEBASE_H
+#define TIMEBASE_H
+
+#include <avr/io.h>
+#include <stdint.h>
+#include <util/atomic.h>
+
+#include "reg.h"
+
+/**
+ * Base de tempo do programa. O Timer1 conta livremente com prescaler de 1, então
+ * cada tick corresponde a um ciclo de CPU, e o contador de 16 bits dá a volta a
+ * cada 65536 ciclos. Diferenças entre duas leituras de `timebase_now` são
+ * corretas (em aritmética módulo 2^16) enquanto o intervalo medido for menor
+ * que isso.
+ *
+ * Intervalos que podem ser mais longos (a FFT, os períodos de sono em idle, a
+ * latência de um evento atrás dela) são medidos com `timebase_now32`, que
+ * junta ao contador as voltas contadas pela interrupção de overflow do
+ * Timer1, e dá a volta só a cada 71 minutos. A interrupção não aninha, para
+ * que uma leitura dentro de outra interrupção nunca encontre a flag de
+ * overflow já limpa e a volta ainda não contada. Nos modos de sono em que o
+ * Timer1 para, as voltas também param.
+ */
+
+
+// Voltas do Timer1 desde o início da base de tempo
+extern volatile uint16_t timebase_overflows;
+
+
+// Inicia o Timer1 em modo normal, com prescaler de 1
+static inline void timebase_init(void) {
+    TCCR1A = REG_CONFIG(TCCR1A, REG_FIELD(TCCR1A_WGM, 0));
+    TCCR1B = REG_CONFIG(TCCR1B, REG_FIELD(TCCR1B_WGM, 0), REG_FIELD(TCCR1B_CS, TIMER_CLOCK_1));
+    TIMSK1 = 1<<TOIE1;
+}
+
+// Retorna o valor atual do contador, em ciclos de CPU. A leitura dos 16 bits
+// passa pelo registrador TEMP, compartilhado com as leituras do TCNT1 e as
+// escritas do OCR1B nas interrupções, então é feita com as interrupções
+// desabilitadas, o que também a torna segura nas rotinas aninhadas
+static inline uint16_t timebase_now(void) {
+    uint16_t now;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        now = TCNT1;
+    }
+    return now;
+}
+
+// Retorna o valor atual do contador em 32 bits, com as voltas do Timer1 nos
+// 16 bits altos. Uma volta que aconteceu com as interrupções desabilitadas,
+// ainda não contada pela interrupção, é somada aqui
+static inline uint32_t timebase_now32(void) {
+    uint16_t low;
+    uint16_t high;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        low = TCNT1;
+        high = timebase_overflows;
+        if ((TIFR1 & 1<<TOV1) && low < 0x8000) {
+            high += 1;
+        }
+    }
+    return (uint32_t) high << 16 | low;
+}
+
+#endif
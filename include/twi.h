@@ -0,0 +1,105 @@
+#ifndef TWI_H
+#define TWI_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Interface TWI (I2C) escrava, para hosts que preferem consultar as amostras
+ * a interpretar o stream da serial.
+ *
+ * O mestre acessa um mapa de registradores de 8 bits. O primeiro byte de uma
+ * escrita seleciona o endereço do registrador, e os bytes seguintes são
+ * escritos a partir dele. Uma leitura (normalmente após um repeated start)
+ * começa no endereço selecionado. O endereço avança a cada byte, exceto no
+ * registrador `TWI_REG_FIFO_DATA`, em que cada par de bytes lidos retira uma
+ * amostra da fila (byte baixo primeiro). Assim, uma única leitura a partir de
+ * `TWI_REG_FIFO_COUNT` retorna a quantidade de amostras na fila seguida das
+ * próprias amostras. Valores de 16 e 32 bits são little-endian, e endereços
+ * fora do mapa são lidos como 0xFF.
+ *
+ *     0x00        identificação (`TWI_ID`)
+ *     0x01        versão do mapa
+ *     0x02        quantidade de canais
+ *     0x04-0x13   última amostra de cada canal (16 bits, até 8 canais)
+ *     0x14        quantidade de amostras na fila
+ *     0x15        leitura da fila
+ *     0x18-0x1B   amostras lidas desde a inicialização (32 bits)
+ *     0x1C-0x1D   amostras descartadas por falta de espaço na fila
+ *     0x20-0x21   taxa de amostragem, em Hz (leitura e escrita)
+ *     0x22        flags da configuração (leitura e escrita, ver `config.h`)
+ *     0x23        controle (leitura e escrita, `TWI_CONTROL_*`)
+ *
+ * Somente os registradores de configuração (0x20 a 0x23) podem ser escritos.
+ * Ao fim de uma escrita neles, a interrupção posta o evento `EVENT_TWI`, e a
+ * nova configuração é aplicada no contexto principal. Os bytes escritos pelo
+ * mestre não são sobrescritos pela publicação da configuração (um comando da
+ * serial tratado antes do evento, ou durante a transação) até serem lidos
+ * por `twi_read_config`, então a escrita do mestre nunca é perdida.
+ *
+ * Tudo é feito pela interrupção do TWI, em paralelo com a amostragem. Durante
+ * uma leitura, o contexto principal não altera o mapa, então todos os valores
+ * lidos em uma mesma transação são consistentes entre si (a fila continua
+ * recebendo amostras normalmente). Durante uma transação, o TWI é requisitado
+ * ao gerenciador de energia, pois a transferência dos dados precisa do clock
+ * de I/O. Fora delas, o reconhecimento do endereço funciona em qualquer modo
+ * de sono e acorda a CPU.
+ *
+ * As linhas SDA (PC4) e SCL (PC5) precisam de pull-ups externos, pois os
+ * internos, habilitados em `main`, são fracos demais para 100 kHz.
+ */
+
+
+// Identificação e versão do mapa de registradores
+#define TWI_ID 0xAD
+#define TWI_VERSION 1
+
+// Quantidade máxima de canais no mapa
+#define TWI_CHANNELS_MAX 8
+
+// Endereços dos registradores
+#define TWI_REG_ID 0x00
+#define TWI_REG_VERSION 0x01
+#define TWI_REG_CHANNELS 0x02
+#define TWI_REG_SAMPLE 0x04
+#define TWI_REG_FIFO_COUNT 0x14
+#define TWI_REG_FIFO_DATA 0x15
+#define TWI_REG_SAMPLES 0x18
+#define TWI_REG_FIFO_DROPPED 0x1C
+#define TWI_REG_SAMPLING_RATE 0x20
+#define TWI_REG_FLAGS 0x22
+#define TWI_REG_CONTROL 0x23
+
+#define TWI_REGISTERS_SIZE 0x24
+
+// Bits do registrador de controle
+// Mantém a amostragem ligada para o mestre, mesmo sem transmissão pela serial
+#define TWI_CONTROL_SAMPLING (1<<0)
+// Grava a configuração na EEPROM (sempre lido como 0)
+#define TWI_CONTROL_SAVE (1<<1)
+
+
+// Configuração escrita pelo mestre
+struct twi_config {
+    uint16_t sampling_rate;
+    uint8_t flags;
+    uint8_t control;
+};
+
+
+// Habilita o TWI como escravo no endereço `TWI_ADDRESS` (ver `config.h`), com
+// `channels` canais no mapa
+void twi_init(uint8_t channels);
+
+// Atualiza a última amostra do canal e a insere na fila
+void twi_add_sample(uint8_t channel, uint16_t sample);
+
+// Lê a configuração escrita pelo mestre, liberando os seus bytes para a
+// próxima publicação
+void twi_read_config(struct twi_config *twi_config);
+
+// Atualiza os registradores de configuração com a configuração atual, exceto
+// os bytes escritos pelo mestre e ainda não lidos
+void twi_publish_config(uint8_t control);
+
+#endif
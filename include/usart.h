@@ -0,0 +1,129 @@
+#ifndef USART_H
+#define USART_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Comunicação pela USART, com recepção e transmissão por interrupções.
+ *
+ * Os bytes recebidos são colocados em uma fila pela interrupção de recepção,
+ * que posta o evento `EVENT_COMMAND` para o escalonador. Os bytes a transmitir
+ * são colocados pelo contexto principal em uma de duas filas, e enviados pela
+ * interrupção de buffer vazio (UDRE), então a transmissão não bloqueia o
+ * programa enquanto houver espaço na fila.
+ *
+ * As duas filas são canais com prioridades diferentes, multiplexados no mesmo
+ * fio:
+ *
+ * - controle (`USART_CHANNEL_CONTROL`): respostas aos comandos, sempre
+ *   transmitidas antes de qualquer byte pendente do outro canal;
+ * - dados (`USART_CHANNEL_DATA`): o stream de amostras e os avisos que fazem
+ *   parte dele (como "#rate"), na ordem em que foram produzidos.
+ *
+ * Antes do primeiro byte de um canal diferente do último transmitido, é
+ * transmitido o byte `USART_CHANNEL_MARKER | canal`, que nunca aparece no
+ * texto (ASCII). O host só precisa acompanhar esses marcadores para separar
+ * os canais. Como a troca pode acontecer no meio de uma linha, uma resposta
+ * sai no máximo dois bytes depois de ser colocada na fila (o byte em
+ * transmissão e o marcador), mesmo com o stream saturando a serial.
+ *
+ * Enquanto há bytes sendo transmitidos, a USART é requisitada ao gerenciador de
+ * energia (`POWER_USART_TX`). Ela só é liberada pela interrupção de
+ * transmissão concluída, quando o último byte já saiu do shift register.
+ *
+ * Compilando com `-DMULTIDROP` (ambiente `multidrop` do PlatformIO), várias
+ * placas compartilham a mesma linha serial, um barramento RS-485 half-duplex
+ * em que só o host fala sem ser consultado. Os frames têm 9 bits de dados: o
+ * nono bit indica um frame de endereço, enviado só pelo host. No modo
+ * multiprocessador (MPCM), a USART de cada placa descarta em hardware os
+ * frames de dados até receber um frame de endereço, sem interromper a CPU:
+ *
+ * - frame de endereço igual a `config.bus_address` (comando 'A'): a placa
+ *   passa a receber os frames de dados seguintes, que são os mesmos comandos
+ *   da serial ponto a ponto, e pode ser consultada;
+ * - frame de endereço `USART_BUS_BROADCAST`: todas as placas recebem os
+ *   comandos seguintes ('1' para iniciar todas, por exemplo), mas nenhuma
+ *   pode ser consultada;
+ * - qualquer outro endereço: a placa volta a ignorar os frames de dados.
+ *
+ * As placas só transmitem quando consultadas. Os bytes dos dois canais ficam
+ * nas filas até o host enviar `USART_BUS_POLL` à placa endereçada. A
+ * interrupção de recepção liga o driver do transceptor (pino DE em PD2) e a
+ * transmissão, que envia os bytes que estavam nas filas no momento da
+ * consulta, começando pelo marcador do canal, seguidos de `USART_BUS_END`.
+ * Quando o último byte sai do shift register, o driver é desligado e o host
+ * pode consultar a próxima placa. O pino /RE do transceptor deve ser ligado
+ * ao DE, para que a placa não receba os próprios bytes.
+ *
+ * Enquanto a placa não é consultada, as amostras que não cabem na fila de
+ * dados são descartadas e contadas, como em uma serial lenta. Os bytes das
+ * respostas aos comandos que não cabem na fila de controle também são
+ * descartados, e contados em `usart_dropped`, para que o programa nunca fique
+ * esperando a próxima consulta. O host deve consultar a placa logo depois de
+ * cada comando, e respostas maiores que a fila (a do comando 's', por
+ * exemplo) chegam incompletas. O log da EEPROM não é
+ * transmitido no barramento (comando 'd'), pois a troca de baud rate afetaria
+ * todas as placas.
+ *
+ * Em uma serial sem frames de 9 bits (a de um PC, por exemplo), o host emula o
+ * nono bit com a paridade: mark (1) nos endereços e space (0) nos dados e nas
+ * respostas das placas.
+ */
+
+
+// Canais de transmissão
+#define USART_CHANNEL_DATA 0
+#define USART_CHANNEL_CONTROL 1
+
+// Marcador de troca de canal no fio (seguido do canal nos bits baixos)
+#define USART_CHANNEL_MARKER 0x80
+
+// Endereço de broadcast do barramento multiponto, e os bytes de dados (que
+// nunca aparecem no texto) da consulta do host e do fim da resposta da placa
+#define USART_BUS_BROADCAST 0
+#define USART_BUS_POLL 0x05
+#define USART_BUS_END 0x04
+
+
+// Caracteres dos dígitos
+extern const uint8_t digits[10];
+
+#ifdef MULTIDROP
+// Quantidade de bytes descartados por `USART_transmit` com as filas cheias,
+// desde a inicialização
+extern uint16_t usart_dropped;
+#endif
+
+
+// Configura a USART no formato 8N1, com velocidade dobrada e o baud rate
+// `BAUD_RATE`
+void USART_init(void);
+
+// Altera o baud rate (em Hz). Deve ser chamada com a transmissão concluída
+void USART_set_baud_rate(uint32_t baud_rate);
+
+// Espera até que todos os bytes das filas de transmissão tenham sido enviados
+void USART_flush(void);
+
+// Remove um byte da fila de recepção. Retorna falso caso ela esteja vazia
+bool USART_receive(uint8_t *data);
+
+// Insere um byte na fila de transmissão do canal, esperando caso ela esteja
+// cheia (no barramento multiponto, o byte é descartado)
+void USART_transmit(uint8_t channel, uint8_t data);
+
+// Insere `n` bytes na fila de transmissão do canal apenas se houver espaço
+// para todos. Retorna falso (sem inserir nenhum) caso contrário
+bool USART_try_transmit(uint8_t channel, const uint8_t *data, uint8_t n);
+
+// Transmite a representação decimal de um valor, sem zeros à esquerda
+void USART_transmit_decimal(uint8_t channel, uint32_t value);
+
+// Transmite os caracteres de uma string terminada em '\0'
+void USART_transmit_string(uint8_t channel, const char *text);
+
+// Transmite uma linha de resposta no formato "#<nome> <valor>"
+void USART_transmit_report(uint8_t channel, const char *name, uint32_t value);
+
+#endif
@@ -1,5 +1,6 @@
 #include <avr/interrupt.h>
 #include <avr/io.h>
+#include <avr/sleep.h>
 #include <stdbool.h>
 
 /**
@@ -11,6 +12,13 @@
  * Buscando a maior precisão possível, devemos escolher o menor valor de prescaler
  * que cumpra esse requisito. Como `PRESCALER = 1` não serve, o próximo valor
  * disponível, `PRESCALER = 8`, é utilizado.
+ *
+ * A interrupção do Timer0 só precisa setar o bit ADSC. Como o valor de ADCSRA
+ * é conhecido (o mesmo da configuração), ela pode ser escrita como uma rotina
+ * `naked`: um `ldi` carrega o valor completo do registrador, sem ler e
+ * modificar, e por isso o SREG não é alterado e só é necessário salvar o
+ * registrador utilizado. Isso evita o prólogo e o epílogo que o compilador
+ * gera para salvar r0, r1 e o SREG.
  */
 
 
@@ -24,10 +32,21 @@
 #define SAMPLES_NUMBER 20
 
 
+// Valor de ADCSRA configurado em `main`
+#define ADCSRA_CONFIG 0b10001100
+
 // Interrupção que é disparada toda vez que o timer atinge TOP
-ISR(TIMER0_COMPA_vect) {
-    // Inicia a conversão do ADC
-    ADCSRA |= 1<<6;
+ISR(TIMER0_COMPA_vect, ISR_NAKED) {
+    // Inicia a conversão do ADC, escrevendo a configuração com o bit ADSC setado
+    __asm__ volatile (
+        "push r24"      "\n\t"
+        "ldi r24, %0"   "\n\t"
+        "sts %1, r24"   "\n\t"
+        "pop r24"       "\n\t"
+        "reti"          "\n\t"
+        :
+        : "M" (ADCSRA_CONFIG | 1<<6), "n" (_SFR_MEM_ADDR(ADCSRA))
+    );
 }
 
 
@@ -85,13 +104,17 @@ int main() {
     // Habilita o ADC
     // Habilita a interrupção quando o ADC termina a conversão
     // Prescaler de 16
-    ADCSRA = 0b10001100;
+    ADCSRA = ADCSRA_CONFIG;
 
 
     // Habilita todas as interrupções
     sei();
 
 
-    // Loop principal, nada a fazer
-    while (true) { }
+    // Loop principal, nada a fazer além de dormir até a próxima interrupção
+    // (o modo idle mantém o Timer0 e o ADC funcionando)
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    while (true) {
+        sleep_mode();
+    }
 }
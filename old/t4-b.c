@@ -1,11 +1,18 @@
 #include <avr/interrupt.h>
 #include <avr/io.h>
+#include <avr/sleep.h>
 #include <stdbool.h>
 
 /**
  * A única diferença desse programa para o anterior é que nesse o ADC inicia a
  * conversão automaticamente quando o Timer0 atinge o TOP (auto-trigger em
  * Timer/Counter0 Compare Match A).
+ *
+ * O auto-trigger é disparado pela borda de subida da flag OCF0A, então ela
+ * precisa ser limpa entre uma conversão e outra. Em vez de habilitar a
+ * interrupção do Timer0 com uma rotina vazia só para que o hardware limpe a
+ * flag, a rotina do ADC a limpa diretamente, economizando a resposta à
+ * interrupção, o prólogo/epílogo e o `reti` a cada amostra.
  */
 
 
@@ -19,16 +26,16 @@
 #define SAMPLES_NUMBER 20
 
 
-// Interrupção que é disparada toda vez que o timer atinge TOP
-ISR(TIMER0_COMPA_vect) { }
-
-
 // Variáveis para salvar os valores do ADC na memória
 volatile uint16_t samples[SAMPLES_NUMBER] = { 0 };
 volatile uint8_t current_sample = 0;
 
 // Interrupção que é disparada quando o ADC completa a conversão
 ISR(ADC_vect) {
+    // Limpa a flag de compare match do Timer0, para que o próximo compare
+    // match dispare uma nova conversão
+    TIFR0 = 1<<OCF0A;
+
     // Realiza a leitura do valor convertido pelo ADC
     samples[current_sample] = ADC;
 
@@ -57,8 +64,9 @@ int main() {
     TCCR0A = 0b00000010;
     TCCR0B = 0b00000010;
 
-    // Habilita a interrupção quando o timer atinge TOP
-    TIMSK0 = 0b00000010;
+    // Nenhuma interrupção do timer é habilitada (a flag de compare match é
+    // limpa pela interrupção do ADC)
+    TIMSK0 = 0b00000000;
 
     // Timer começa em 0
     TCNT0 = 0;
@@ -86,6 +94,10 @@ int main() {
     sei();
 
 
-    // Loop principal, nada a fazer
-    while (true) { }
+    // Loop principal, nada a fazer além de dormir até a próxima interrupção
+    // (o modo idle mantém o Timer0 e o ADC funcionando)
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    while (true) {
+        sleep_mode();
+    }
 }
@@ -1,5 +1,6 @@
 #include <avr/interrupt.h>
 #include <avr/io.h>
+#include <avr/sleep.h>
 #include <stdbool.h>
 
 /**
@@ -7,6 +8,25 @@
  * o valor de 64 pois é o menor prescaler para o qual `CPU_CLOCK / 64 / SAMPLING_RATE - 1`
  * cabe em 8 bits. Os dois outros prescalers menores, 1 e 8, levam a um valor de
  * TOP que estoura a capacidade do contador.
+ *
+ * O auto-trigger do ADC é disparado pela borda de subida da flag OCF0A. Antes,
+ * a interrupção de compare match do Timer0 era habilitada com uma rotina vazia
+ * só para que o hardware limpasse essa flag ao atendê-la, o que custava a
+ * resposta à interrupção, o `jmp` do vetor, o prólogo/epílogo gerado pelo
+ * compilador e o `reti` a cada amostra. Agora a interrupção fica desabilitada
+ * e a própria rotina do ADC limpa a flag (um `ldi` e um `out`), já que a
+ * conversão sempre termina bem antes do próximo compare match.
+ *
+ * As flags acessadas dentro das interrupções ficam no registrador de uso geral
+ * GPIOR0. Como ele está na região baixa do espaço de I/O, cada bit pode ser
+ * alterado ou testado com uma única instrução (`sbi`, `cbi`, `sbis`, `sbic`),
+ * sem passar por registradores e sem alterar o SREG.
+ *
+ * Enquanto não há amostra nova para transmitir, o loop principal dorme em idle
+ * (que mantém o Timer0, o ADC e a USART funcionando) até a próxima interrupção,
+ * em vez de consultar as flags continuamente.
+ *
+ * O custo de cada interrupção pode ser medido no simavr com `tools/sim.c`.
  */
 
 
@@ -20,38 +40,41 @@
 #define BAUD_RATE 9600
 
 
-// Interrupção que é disparada toda vez que o timer atinge TOP
-ISR(TIMER0_COMPA_vect) { }
-
+// Flags do programa, guardadas em GPIOR0
+#define FLAGS GPIOR0
 
 // Flag que indica se uma nova leitura foi realizada
-volatile bool has_new_sample = false;
+#define FLAG_HAS_NEW_SAMPLE 0
+// Flag que indica se os valores devem ser transmitidos pela serial
+#define FLAG_SHOULD_TRANSMIT 1
+
+
 // Variável para salvar o último valor gerado pelo ADC
 volatile uint16_t sample = 0;
 
 // Interrupção que é disparada quando o ADC completa a conversão
 ISR(ADC_vect) {
+    // Limpa a flag de compare match do Timer0, para que o próximo compare
+    // match gere uma nova borda de subida e dispare a próxima conversão
+    TIFR0 = 1<<OCF0A;
     // Informa que há um novo valor que pode ser transimitido
-    has_new_sample = true;
+    FLAGS |= 1<<FLAG_HAS_NEW_SAMPLE;
     // Realiza a leitura do valor convertido pelo ADC
     sample = ADC;
 }
 
 
-// Flag que indica se os valores devem ser transmitidos pela serial
-volatile bool should_transmit = false;
-
 // Interrupção que é disparada quando é recebido um byte pela serial
 ISR(USART_RX_vect) {
     switch (UDR0) {
         case '0':
             // Ao receber '0' pela serial, transmissão é parada
-            should_transmit = false;
+            FLAGS &= ~(1<<FLAG_SHOULD_TRANSMIT);
             break;
 
         case '1':
             // Ao receber '1' pela serial, transmissão é realizada
-            should_transmit = true;
+            FLAGS |= 1<<FLAG_SHOULD_TRANSMIT;
             break;
 
         default:
@@ -92,8 +115,9 @@ int main() {
     TCCR0A = 0b00000010;
     TCCR0B = 0b00000011;
 
-    // Habilita a interrupção quando o timer atinge TOP
-    TIMSK0 = 0b00000010;
+    // Nenhuma interrupção do timer é habilitada (a flag de compare match é
+    // limpa pela interrupção do ADC)
+    TIMSK0 = 0b00000000;
 
     // Timer começa em 0
     TCNT0 = 0;
@@ -137,13 +161,27 @@ int main() {
 
 
     // Loop principal
+    set_sleep_mode(SLEEP_MODE_IDLE);
     while (true) {
-        if (!should_transmit) {
+        // As flags são verificadas com as interrupções desabilitadas. A
+        // instrução seguinte ao `sei` é sempre executada antes de qualquer
+        // interrupção, então uma flag setada entre a verificação e o `sleep`
+        // acorda a CPU em vez de ser perdida
+        cli();
+        if ((FLAGS & 1<<FLAG_SHOULD_TRANSMIT) == 0 || (FLAGS & 1<<FLAG_HAS_NEW_SAMPLE) == 0) {
+            sleep_enable();
+            sei();
+            sleep_cpu();
+            sleep_disable();
+        }
+        sei();
+
+        if ((FLAGS & 1<<FLAG_SHOULD_TRANSMIT) == 0) {
             continue;
         }
 
-        if (has_new_sample) {
-            has_new_sample = false;
+        if (FLAGS & 1<<FLAG_HAS_NEW_SAMPLE) {
+            FLAGS &= ~(1<<FLAG_HAS_NEW_SAMPLE);
 
             uint16_t current_sample = sample;
 
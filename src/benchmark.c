@@ -0,0 +1,120 @@
+#ifdef BENCHMARK
+
+#include "benchmark.h"
+
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#include <util/atomic.h>
+
+#include "fft.h"
+#include "linearize.h"
+#include "log.h"
+#include "median.h"
+#include "ring.h"
+#include "timebase.h"
+#include "usart.h"
+
+
+// Filas com os mesmos tipos e capacidades das filas do programa
+RING_DEFINE(bench_byte_ring, uint8_t, 64)
+RING_DEFINE(bench_word_ring, uint16_t, 8)
+
+static struct bench_byte_ring byte_ring;
+static struct bench_word_ring word_ring;
+
+// Destino dos resultados das funções medidas, para que não sejam descartadas
+static volatile int16_t sink;
+
+// Quantidade de elementos das operações em bloco
+#define BULK_SIZE 6
+
+// Filtro de mediana com a maior janela
+static struct median median;
+
+// Bloco de amostras para a FFT
+static uint16_t fft_block[FFT_POINTS];
+
+// Mede os ciclos gastos por `operation`, com as interrupções desabilitadas
+// para que não interfiram na contagem
+#define MEASURE(cycles, operation)                  \
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {             \
+        uint16_t start = timebase_now();            \
+        operation;                                  \
+        cycles = timebase_now() - start;            \
+    }
+
+void benchmark_run(void) {
+    uint8_t bytes[BULK_SIZE] = { 0 };
+    uint8_t byte;
+    uint16_t word;
+
+    // Custo da medição sem nenhuma operação, descontado dos demais
+    uint16_t overhead;
+    MEASURE(overhead, );
+
+    uint16_t push_byte, pop_byte, push_word, pop_word, push_bulk, pop_bulk;
+    MEASURE(push_byte, bench_byte_ring_push(&byte_ring, 0x55));
+    MEASURE(pop_byte, bench_byte_ring_pop(&byte_ring, &byte));
+    MEASURE(push_word, bench_word_ring_push(&word_ring, 0x0155));
+    MEASURE(pop_word, bench_word_ring_pop(&word_ring, &word));
+    MEASURE(push_bulk, bench_byte_ring_push_bulk(&byte_ring, bytes, BULK_SIZE));
+    MEASURE(pop_bulk, bench_byte_ring_pop_bulk(&byte_ring, bytes, BULK_SIZE));
+
+    // A linearização tem o mesmo custo para qualquer valor e tabela
+    uint16_t linearize_cycles;
+    MEASURE(linearize_cycles, sink = linearize(LINEARIZE_NTC_3950, 0x0155));
+
+    // O custo da mediana depende de onde ficam a amostra retirada e a nova
+    // na janela ordenada. O pior caso é a retirada do fim (a busca passa pela
+    // janela inteira) e a inserção no início (todos os valores são
+    // deslocados): a janela recebe valores decrescentes, e depois um menor
+    // que todos
+    median_reset(&median, MEDIAN_WINDOW_MAX);
+    for (uint8_t i = 0; i < MEDIAN_WINDOW_MAX; ++i) {
+        median_filter(&median, MEDIAN_WINDOW_MAX - i);
+    }
+    uint16_t median_cycles;
+    MEASURE(median_cycles, sink = median_filter(&median, 0));
+
+#ifdef DEBUG_UART
+    // Registros do log (`log.h`): o primeiro inicia a transmissão da serial de
+    // depuração, e o segundo a encontra transmitindo, como nos pontos de
+    // chamada em sequência. Os registros são transmitidos depois
+    uint16_t log_kick, log_record;
+    MEASURE(log_kick, LOG1(BOOT_READY, 0x0155));
+    MEASURE(log_record, LOG2(SAMPLE_DROPPED, 0x0001, 0x0155));
+#endif
+
+    (void) byte;
+    (void) word;
+
+    // A FFT passa de 65536 ciclos, então é medida com as voltas do Timer1 e
+    // com as interrupções habilitadas. A transmissão é concluída antes, para
+    // que a interrupção da USART não entre na contagem
+    for (uint8_t i = 0; i < FFT_POINTS; ++i) {
+        fft_block[i] = i & 8 ? 0x0300 : 0x0100;
+    }
+    USART_flush();
+    uint32_t long_overhead = timebase_now32();
+    long_overhead = timebase_now32() - long_overhead;
+    uint32_t fft_cycles = timebase_now32();
+    fft_magnitudes(fft_block);
+    fft_cycles = timebase_now32() - fft_cycles - long_overhead;
+
+    USART_transmit_report(USART_CHANNEL_CONTROL, "bench_overhead", overhead);
+    USART_transmit_report(USART_CHANNEL_CONTROL, "bench_push_u8", push_byte - overhead);
+    USART_transmit_report(USART_CHANNEL_CONTROL, "bench_pop_u8", pop_byte - overhead);
+    USART_transmit_report(USART_CHANNEL_CONTROL, "bench_push_u16", push_word - overhead);
+    USART_transmit_report(USART_CHANNEL_CONTROL, "bench_pop_u16", pop_word - overhead);
+    USART_transmit_report(USART_CHANNEL_CONTROL, "bench_push_bulk_6", push_bulk - overhead);
+    USART_transmit_report(USART_CHANNEL_CONTROL, "bench_pop_bulk_6", pop_bulk - overhead);
+    USART_transmit_report(USART_CHANNEL_CONTROL, "bench_linearize", linearize_cycles - overhead);
+    USART_transmit_report(USART_CHANNEL_CONTROL, "bench_median_9", median_cycles - overhead);
+    USART_transmit_report(USART_CHANNEL_CONTROL, "bench_fft", fft_cycles);
+#ifdef DEBUG_UART
+    USART_transmit_report(USART_CHANNEL_CONTROL, "bench_log_1_kick", log_kick - overhead);
+    USART_transmit_report(USART_CHANNEL_CONTROL, "bench_log_2", log_record - overhead);
+#endif
+}
+
+#endif
@@ -0,0 +1,56 @@
+#include "config.h"
+
+#include <avr/eeprom.h>
+#include <stdbool.h>
+#include <util/crc16.h>
+
+
+struct config config;
+
+// Configuração salva na EEPROM, seguida do CRC
+static struct config EEMEM saved_config;
+static uint8_t EEMEM saved_crc;
+
+
+static uint8_t config_crc(const struct config *c) {
+    const uint8_t *bytes = (const uint8_t *) c;
+    uint8_t crc = 0;
+    for (uint8_t i = 0; i < sizeof(*c); ++i) {
+        crc = _crc8_ccitt_update(crc, bytes[i]);
+    }
+    return crc;
+}
+
+void config_load(void) {
+    eeprom_read_block(&config, &saved_config, sizeof(config));
+
+    bool valid = config.version == CONFIG_VERSION
+        && config_crc(&config) == eeprom_read_byte(&saved_crc);
+
+    if (!valid) {
+        config.version = CONFIG_VERSION;
+        config.flags = AUTO_START ? CONFIG_AUTO_START : 0;
+        config.sampling_rate = SAMPLING_RATE;
+        config.adaptive_min = ADAPTIVE_RATE_MIN;
+        config.adaptive_max = ADAPTIVE_RATE_MAX;
+        config.setpoint = CONTROL_SETPOINT;
+        config.kp = CONTROL_KP;
+        config.ki = CONTROL_KI;
+        config.kd = CONTROL_KD;
+        config.events_middle = EVENTS_MIDDLE;
+        config.events_hysteresis = EVENTS_HYSTERESIS;
+        config.histogram_shift = HISTOGRAM_SHIFT;
+        config.histogram_period = HISTOGRAM_PERIOD;
+        config.calibration_id = CALIBRATION_ID;
+        config.bus_address = MULTIDROP_ADDRESS;
+        for (uint8_t i = 0; i < CHANNELS_NUMBER; ++i) {
+            config.linearize[i] = LINEARIZE_TABLE;
+            config.median[i] = MEDIAN_WINDOW;
+        }
+    }
+}
+
+void config_save(void) {
+    eeprom_update_block(&config, &saved_config, sizeof(config));
+    eeprom_update_byte(&saved_crc, config_crc(&config));
+}
@@ -0,0 +1,131 @@
+#ifdef DEBUG_UART
+
+#include "debug.h"
+
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#include <util/atomic.h>
+
+#include "config.h"
+#include "power.h"
+#include "reg.h"
+
+
+// Duração de um bit, em ciclos do Timer1 (prescaler de 1)
+#define BIT_CYCLES ((CPU_CLOCK + DEBUG_BAUD_RATE / 2) / DEBUG_BAUD_RATE)
+
+_Static_assert(
+    ((uint32_t) BIT_CYCLES * DEBUG_BAUD_RATE > CPU_CLOCK
+        ? (uint32_t) BIT_CYCLES * DEBUG_BAUD_RATE - CPU_CLOCK
+        : CPU_CLOCK - (uint32_t) BIT_CYCLES * DEBUG_BAUD_RATE) * 50 <= CPU_CLOCK,
+    "o erro do baud rate de depuração deve ser no máximo 2%");
+
+// Bits de um frame 8N1 (start, 8 bits de dados e stop)
+#define FRAME_BITS 10
+
+// Menor antecedência, em ciclos, entre o cálculo de uma borda e o momento
+// dela, para que o OCR1B seja escrito a tempo
+#define EDGE_MARGIN DEBUG_KICK_CYCLES
+
+// Configuração do TCCR1A: modo normal (o da base de tempo), com a saída OC1B
+// indo para `level` no próximo compare match
+#define TCCR1A_CONFIG(level) REG_CONFIG(TCCR1A,                                 \
+    REG_FIELD(TCCR1A_COM1B, (level) ? TIMER_COM_SET : TIMER_COM_CLEAR),         \
+    REG_FIELD(TCCR1A_WGM, 0))
+
+
+struct debug_ring debug_ring;
+struct debug_stats debug_stats;
+volatile bool debug_busy = false;
+
+// Frame em transmissão: o bit 0 é o nível atual da linha, seguido dos bits
+// seguintes, e `remaining` é a quantidade desses bits que ainda não terminou
+static uint16_t frame;
+static uint8_t remaining;
+
+// Momento da borda programada no OCR1B, ou do fim do último stop bit com a
+// transmissão parada. Guardado para que a interrupção não precise ler o OCR1B
+static uint16_t edge;
+
+
+// Carrega o próximo byte da fila, com o start bit começando em `edge`.
+// Retorna falso caso a fila esteja vazia
+static inline bool load_frame(void) {
+    uint8_t data;
+    if (!debug_ring_pop(&debug_ring, &data)) {
+        return false;
+    }
+    // Start bit (0), dados do LSB para o MSB e stop bit (1)
+    frame = (uint16_t) data << 1 | 1<<(FRAME_BITS - 1);
+    remaining = FRAME_BITS;
+    TCCR1A = TCCR1A_CONFIG(0);
+    OCR1B = edge;
+    return true;
+}
+
+// A rotina não aninha: ela é curta, precisa programar a próxima borda antes
+// que ela chegue, e escreve o OCR1B, cujo byte alto passa pelo registrador
+// TEMP, compartilhado com as leituras do TCNT1 em outras interrupções
+ISR(TIMER1_COMPB_vect) {
+    uint16_t next = edge;
+
+    if (remaining != 0) {
+        // A linha acabou de mudar para o nível do bit 0 do frame. A próxima
+        // borda é no fim da sequência de bits iguais a ele
+        uint8_t level = frame & 1;
+        do {
+            frame >>= 1;
+            next += BIT_CYCLES;
+            remaining -= 1;
+        } while (remaining != 0 && (frame & 1) == level);
+
+        if (remaining != 0) {
+            if ((int16_t) (next - TCNT1) >= EDGE_MARGIN) {
+                edge = next;
+                TCCR1A = TCCR1A_CONFIG(frame & 1);
+                OCR1B = next;
+                return;
+            }
+            // A borda já passou, ou está perto demais: o frame é abortado com
+            // a linha em 1, em repouso por um frame inteiro
+            TCCR1A = TCCR1A_CONFIG(1);
+            TCCR1C = 1<<FOC1B;
+            debug_stats.late += 1;
+            next = TCNT1 + FRAME_BITS * BIT_CYCLES;
+        }
+    }
+
+    // Fim de um frame, ou início da transmissão (`debug_kick`): o start bit do
+    // próximo byte começa no fim do último stop bit. Só o repouso entre dois
+    // frames aumenta quando não há mais tempo para programá-lo, ou quando o
+    // último stop bit terminou há muito tempo (a diferença deu a volta)
+    int16_t ahead = next - TCNT1;
+    if (ahead < EDGE_MARGIN || ahead > FRAME_BITS * BIT_CYCLES) {
+        next = TCNT1 + EDGE_MARGIN;
+    }
+    edge = next;
+    if (!load_frame()) {
+        TIMSK1 &= ~(1<<OCIE1B);
+        debug_busy = false;
+    }
+}
+
+
+void debug_init(void) {
+    // O registrador da saída OC1B começa em 0, então é forçado a 1 antes de o
+    // pino se tornar uma saída, para que a linha não passe por 0
+    TCCR1A = TCCR1A_CONFIG(1);
+    TCCR1C = 1<<FOC1B;
+    DDRB |= 1<<DDB2;
+
+    power_require(POWER_TIMER1);
+}
+
+void debug_read_stats(struct debug_stats *stats) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        *stats = debug_stats;
+        debug_stats = (struct debug_stats) { 0 };
+    }
+}
+
+#endif
@@ -0,0 +1,180 @@
+#include "detector.h"
+
+#include <stdbool.h>
+
+
+// Nível médio e limiares da histerese
+static uint16_t middle;
+static uint16_t high;
+static uint16_t low;
+
+// Indica se já houve uma amostra, e se o sinal está acima do nível
+static bool started;
+static bool above;
+
+// Amostra anterior e o seu instante
+static uint16_t last_sample;
+static uint32_t last_time;
+
+// Instante da última passagem pelo nível médio, ainda não confirmada pela
+// histerese
+static bool crossing_valid;
+static uint32_t crossing_time;
+
+// Extremo do meio ciclo atual: o seu valor e instante, e as amostras vizinhas.
+// O extremo do primeiro meio ciclo, que pode ter começado antes da primeira
+// amostra, não é emitido
+static bool extreme_valid;
+static bool extreme_next_pending;
+static uint16_t extreme_value;
+static uint32_t extreme_time;
+static uint16_t extreme_previous;
+static uint16_t extreme_next;
+
+
+void detector_reset(uint16_t new_middle, uint16_t hysteresis) {
+    middle = new_middle;
+    high = new_middle + hysteresis;
+    low = new_middle > hysteresis ? new_middle - hysteresis : 0;
+    started = false;
+}
+
+// Começa um novo meio ciclo na amostra atual
+static void start_extreme(uint32_t time, uint16_t sample) {
+    extreme_value = sample;
+    extreme_time = time;
+    extreme_previous = last_sample;
+    extreme_next_pending = true;
+}
+
+// Refina o extremo pela parábola que passa pelas três amostras em torno dele
+static void emit_extreme(uint8_t type, struct detector_event *event) {
+    int16_t previous = extreme_previous;
+    int16_t center = extreme_value;
+    int16_t next = extreme_next_pending ? center : (int16_t) extreme_next;
+
+    // Deslocamento do vértice em relação à amostra extrema, em 1/256 de
+    // período: (y₋₁ - y₁) / (2 * (y₋₁ - 2y₀ + y₁)), limitado a meia amostra
+    int16_t curvature = previous - 2 * center + next;
+    int16_t difference = previous - next;
+    int16_t offset = 0;
+    if (curvature != 0) {
+        offset = (int32_t) difference * 128 / curvature;
+        if (offset > 128) {
+            offset = 128;
+        } else if (offset < -128) {
+            offset = -128;
+        }
+    }
+
+    event->type = type;
+    event->time = extreme_time * 256 + offset;
+    // Valor no vértice: y₀ - (y₋₁ - y₁) * deslocamento / 4
+    event->value = center - (int32_t) difference * offset / 1024;
+}
+
+// Instante em que o segmento entre a amostra anterior e a atual passa pelo
+// nível médio
+static uint32_t interpolate_crossing(uint32_t time, uint16_t sample) {
+    int16_t rise = (int16_t) (sample - last_sample);
+    int16_t distance = (int16_t) (middle - last_sample);
+    uint32_t fraction = (uint32_t) ((int32_t) distance * 256 / rise) * (time - last_time);
+    return last_time * 256 + fraction;
+}
+
+uint8_t detector_add(
+    uint32_t time, uint16_t sample, struct detector_event events[DETECTOR_EVENTS_MAX]
+) {
+    if (!started) {
+        started = true;
+        above = sample >= middle;
+        crossing_valid = false;
+        extreme_valid = false;
+        last_sample = sample;
+        last_time = time;
+        start_extreme(time, sample);
+        return 0;
+    }
+
+    uint8_t n = 0;
+
+    // Passagem pelo nível médio, no sentido oposto ao do estado atual. Uma
+    // volta antes da confirmação a cancela
+    if (!above) {
+        if (last_sample < middle && sample >= middle) {
+            crossing_time = interpolate_crossing(time, sample);
+            crossing_valid = true;
+        } else if (sample < middle) {
+            crossing_valid = false;
+        }
+    } else {
+        if (last_sample >= middle && sample < middle) {
+            crossing_time = interpolate_crossing(time, sample);
+            crossing_valid = true;
+        } else if (sample >= middle) {
+            crossing_valid = false;
+        }
+    }
+
+    // Extremo do meio ciclo
+    if (above ? sample > extreme_value : sample < extreme_value) {
+        start_extreme(time, sample);
+    } else if (extreme_next_pending) {
+        extreme_next = sample;
+        extreme_next_pending = false;
+    }
+
+    // Confirmação do cruzamento pela histerese
+    bool rising = !above && sample >= high;
+    bool falling = above && sample <= low;
+    if (rising || falling) {
+        if (extreme_valid) {
+            emit_extreme(rising ? DETECTOR_VALLEY : DETECTOR_PEAK, &events[n++]);
+        }
+        if (crossing_valid) {
+            events[n].type = rising ? DETECTOR_RISING : DETECTOR_FALLING;
+            events[n].time = crossing_time;
+            events[n].value = 0;
+            n += 1;
+        }
+
+        above = rising;
+        crossing_valid = false;
+        extreme_valid = true;
+        start_extreme(time, sample);
+    }
+
+    last_sample = sample;
+    last_time = time;
+    return n;
+}
+
+
+// Escreve `value` em decimal. Retorna a quantidade de bytes escritos
+static uint8_t format_decimal(uint32_t value, uint8_t *out) {
+    uint8_t digits[10];
+    uint8_t n = 0;
+    do {
+        digits[n++] = '0' + value%10;
+        value /= 10;
+    } while (value != 0);
+
+    uint8_t length = 0;
+    while (n > 0) {
+        out[length++] = digits[--n];
+    }
+    return length;
+}
+
+uint8_t detector_format(const struct detector_event *event, uint8_t out[DETECTOR_EVENT_MAX]) {
+    uint8_t length = 0;
+    out[length++] = event->type;
+    length += format_decimal(event->time, out + length);
+    if (event->type == DETECTOR_PEAK || event->type == DETECTOR_VALLEY) {
+        out[length++] = ',';
+        length += format_decimal(event->value, out + length);
+    }
+    out[length++] = '\r';
+    out[length++] = '\n';
+    return length;
+}
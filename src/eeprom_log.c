@@ -0,0 +1,181 @@
+#include "eeprom_log.h"
+
+#include <avr/eeprom.h>
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#include <util/crc16.h>
+
+#include "interrupts.h"
+
+
+uint16_t eeprom_log_dropped = 0;
+
+// Área do log na EEPROM
+static uint8_t EEMEM log_area[EEPROM_LOG_RECORDS][EEPROM_LOG_RECORD_SIZE];
+
+// Posição do registro mais recente e número de sequência do próximo registro,
+// encontrados na primeira vez em que o log é utilizado (ver `find_last_slot`)
+static bool found_last_slot = false;
+static uint8_t last_slot = EEPROM_LOG_RECORDS - 1;
+static uint16_t next_sequence = 0;
+
+// Registro sendo montado no contexto principal
+static uint8_t record[EEPROM_LOG_RECORD_SIZE];
+static uint8_t record_samples = 0;
+static uint16_t record_last_sample;
+
+// Registro sendo escrito pela interrupção
+static uint8_t write_buffer[EEPROM_LOG_RECORD_SIZE];
+static uint8_t *write_address;
+static volatile uint8_t write_index = EEPROM_LOG_RECORD_SIZE;
+
+
+static uint8_t record_crc(const uint8_t *r) {
+    uint8_t crc = 0;
+    for (uint8_t i = 0; i < EEPROM_LOG_RECORD_SIZE - 1; ++i) {
+        crc = _crc8_ccitt_update(crc, r[i]);
+    }
+    return crc;
+}
+
+// Lê o registro da posição `slot`, retornando se ele é válido
+static bool read_slot(uint8_t slot, uint8_t *r) {
+    eeprom_read_block(r, log_area[slot], EEPROM_LOG_RECORD_SIZE);
+    return r[2] >= 1 && r[2] <= EEPROM_LOG_SAMPLES
+        && record_crc(r) == r[EEPROM_LOG_RECORD_SIZE - 1];
+}
+
+static uint16_t record_sequence(const uint8_t *r) {
+    return r[0] | (uint16_t) r[1] << 8;
+}
+
+
+// Interrupção que é disparada quando a EEPROM está pronta para uma escrita
+ISR(EE_READY_vect) {
+    // A interrupção fica ativa enquanto a EEPROM estiver pronta, então é
+    // mascarada antes de aninhar (ver `interrupts.h`), e só é desmascarada
+    // quando uma escrita é iniciada
+    EECR &= ~(1<<EERIE);
+    INTERRUPT_NEST();
+
+    while (write_index < EEPROM_LOG_RECORD_SIZE) {
+        uint8_t index = write_index;
+        write_index = index + 1;
+
+        // Só escreve bytes que mudaram
+        EEAR = (uint16_t) (write_address + index);
+        EECR |= 1<<EERE;
+        if (EEDR != write_buffer[index]) {
+            EEDR = write_buffer[index];
+            // Sequência temporizada: EEPE deve ser setado até 4 ciclos
+            // depois de EEMPE (ambos com `sbi`), sem interrupções no meio
+            INTERRUPT_UNNEST();
+            EECR |= 1<<EEMPE;
+            EECR |= 1<<EEPE;
+            EECR |= 1<<EERIE;
+            return;
+        }
+    }
+
+    // Registro escrito por completo: a interrupção continua mascarada
+    INTERRUPT_UNNEST();
+}
+
+
+// Encontra a posição do registro mais recente. Como a leitura e a verificação
+// de todos os registros levam alguns milissegundos, isso só é feito quando o
+// log é utilizado pela primeira vez, e não na inicialização
+static void find_last_slot(void) {
+    if (found_last_slot) {
+        return;
+    }
+    found_last_slot = true;
+
+    uint8_t r[EEPROM_LOG_RECORD_SIZE];
+    uint8_t next[EEPROM_LOG_RECORD_SIZE];
+
+    bool valid = read_slot(0, r);
+    for (uint8_t slot = 0; slot < EEPROM_LOG_RECORDS; ++slot) {
+        uint8_t next_slot = slot + 1 == EEPROM_LOG_RECORDS ? 0 : slot + 1;
+        bool next_valid = read_slot(next_slot, next);
+
+        if (valid && (!next_valid || record_sequence(next) != record_sequence(r) + 1)) {
+            last_slot = slot;
+            next_sequence = record_sequence(r) + 1;
+            return;
+        }
+
+        for (uint8_t i = 0; i < EEPROM_LOG_RECORD_SIZE; ++i) {
+            r[i] = next[i];
+        }
+        valid = next_valid;
+    }
+}
+
+bool eeprom_log_busy(void) {
+    return write_index < EEPROM_LOG_RECORD_SIZE;
+}
+
+void eeprom_log_flush(void) {
+    if (record_samples == 0) {
+        return;
+    }
+
+    record[0] = next_sequence;
+    record[1] = next_sequence >> 8;
+    record[2] = record_samples;
+    record[EEPROM_LOG_RECORD_SIZE - 1] = record_crc(record);
+    record_samples = 0;
+
+    find_last_slot();
+
+    if (eeprom_log_busy()) {
+        eeprom_log_dropped += 1;
+        return;
+    }
+
+    last_slot = last_slot + 1 == EEPROM_LOG_RECORDS ? 0 : last_slot + 1;
+    next_sequence += 1;
+
+    for (uint8_t i = 0; i < EEPROM_LOG_RECORD_SIZE; ++i) {
+        write_buffer[i] = record[i];
+    }
+    write_address = log_area[last_slot];
+    write_index = 0;
+    EECR |= 1<<EERIE;
+}
+
+void eeprom_log_add(uint16_t sample) {
+    if (record_samples > 0) {
+        int16_t delta = sample - record_last_sample;
+        if (delta >= -128 && delta <= 127) {
+            record[3 + record_samples + 1] = (int8_t) delta;
+            record_samples += 1;
+            record_last_sample = sample;
+            if (record_samples == EEPROM_LOG_SAMPLES) {
+                eeprom_log_flush();
+            }
+            return;
+        }
+        // Diferença grande demais: fecha o registro e começa outro
+        eeprom_log_flush();
+    }
+
+    for (uint8_t i = 0; i < EEPROM_LOG_RECORD_SIZE; ++i) {
+        record[i] = 0;
+    }
+    record[3] = sample;
+    record[4] = sample >> 8;
+    record_samples = 1;
+    record_last_sample = sample;
+}
+
+bool eeprom_log_read(uint8_t i, uint8_t r[EEPROM_LOG_RECORD_SIZE]) {
+    find_last_slot();
+
+    uint8_t slot = last_slot + 1 + i;
+    while (slot >= EEPROM_LOG_RECORDS) {
+        slot -= EEPROM_LOG_RECORDS;
+    }
+    return read_slot(slot, r);
+}
@@ -0,0 +1,154 @@
+#include "fft.h"
+
+#ifdef __AVR__
+#include <avr/pgmspace.h>
+#else
+// No host, as tabelas ficam na memória comum
+#define PROGMEM
+#define pgm_read_word(address) (*(const uint16_t *) (address))
+#endif
+
+
+// Seno em Q15 de 2πk/N, para k de 0 a 3N/4 - 1. O cosseno é o seno
+// deslocado de N/4
+static const int16_t sine[FFT_POINTS * 3 / 4] PROGMEM = {
+#if FFT_POINTS == 64
+        0, 3212, 6393, 9512, 12540, 15447, 18205, 20788,
+        23170, 25330, 27246, 28899, 30274, 31357, 32138, 32610,
+        32767, 32610, 32138, 31357, 30274, 28899, 27246, 25330,
+        23170, 20788, 18205, 15447, 12540, 9512, 6393, 3212,
+        0, -3212, -6393, -9512, -12540, -15447, -18205, -20788,
+        -23170, -25330, -27246, -28899, -30274, -31357, -32138, -32610,
+#else
+        0, 1608, 3212, 4808, 6393, 7962, 9512, 11039,
+        12540, 14010, 15447, 16846, 18205, 19520, 20788, 22006,
+        23170, 24279, 25330, 26320, 27246, 28106, 28899, 29622,
+        30274, 30853, 31357, 31786, 32138, 32413, 32610, 32729,
+        32767, 32729, 32610, 32413, 32138, 31786, 31357, 30853,
+        30274, 29622, 28899, 28106, 27246, 26320, 25330, 24279,
+        23170, 22006, 20788, 19520, 18205, 16846, 15447, 14010,
+        12540, 11039, 9512, 7962, 6393, 4808, 3212, 1608,
+        0, -1608, -3212, -4808, -6393, -7962, -9512, -11039,
+        -12540, -14010, -15447, -16846, -18205, -19520, -20788, -22006,
+        -23170, -24279, -25330, -26320, -27246, -28106, -28899, -29622,
+        -30274, -30853, -31357, -31786, -32138, -32413, -32610, -32729,
+#endif
+};
+
+// Janela de Hann em Q15, 0,5 * (1 - cos(2πn/N)), para n de 0 a N/2. A outra
+// metade é simétrica
+static const int16_t window[FFT_POINTS / 2 + 1] PROGMEM = {
+#if FFT_POINTS == 64
+        0, 79, 315, 705, 1247, 1935, 2761, 3719,
+        4799, 5990, 7282, 8661, 10114, 11628, 13188, 14778,
+        16384, 17990, 19580, 21140, 22654, 24107, 25486, 26778,
+        27969, 29049, 30007, 30833, 31521, 32063, 32453, 32689,
+        32767,
+#else
+        0, 20, 79, 177, 315, 491, 705, 958,
+        1247, 1573, 1935, 2331, 2761, 3224, 3719, 4244,
+        4799, 5381, 5990, 6624, 7282, 7961, 8661, 9379,
+        10114, 10864, 11628, 12403, 13188, 13980, 14778, 15580,
+        16384, 17188, 17990, 18788, 19580, 20365, 21140, 21904,
+        22654, 23389, 24107, 24807, 25486, 26144, 26778, 27387,
+        27969, 28524, 29049, 29544, 30007, 30437, 30833, 31195,
+        31521, 31810, 32063, 32277, 32453, 32591, 32689, 32748,
+        32767,
+#endif
+};
+
+
+// Parte imaginária do bloco sendo transformado. A parte real fica no próprio
+// bloco
+static int16_t imaginary[FFT_POINTS];
+
+
+// Produto de dois valores Q15
+static inline int16_t multiply(int16_t a, int16_t b) {
+    return ((int32_t) a * b) >> 15;
+}
+
+// Raiz quadrada inteira (arredondada para baixo)
+static uint16_t isqrt(uint32_t value) {
+    uint32_t root = 0;
+    uint32_t bit = (uint32_t) 1 << 30;
+    while (bit > value) {
+        bit >>= 2;
+    }
+    while (bit != 0) {
+        if (value >= root + bit) {
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return root;
+}
+
+void fft_magnitudes(uint16_t block[FFT_POINTS]) {
+    // Nível DC do bloco, removido antes da janela
+    uint32_t sum = 0;
+    for (uint8_t i = 0; i < FFT_POINTS; ++i) {
+        sum += block[i];
+    }
+    uint16_t mean = sum / FFT_POINTS;
+
+    // Aplica a janela, no próprio bloco
+    int16_t *real = (int16_t *) block;
+    for (uint8_t i = 0; i < FFT_POINTS; ++i) {
+        uint8_t index = i <= FFT_POINTS / 2 ? i : FFT_POINTS - i;
+        int16_t centered = (int16_t) (block[i] - mean) << FFT_INPUT_SHIFT;
+        real[i] = multiply(centered, pgm_read_word(&window[index]));
+        imaginary[i] = 0;
+    }
+
+    // Coloca o bloco na ordem de bits invertidos, como pedido pela FFT com
+    // decimação no tempo
+    for (uint8_t i = 0, j = 0; i < FFT_POINTS; ++i) {
+        if (i < j) {
+            int16_t swap = real[i];
+            real[i] = real[j];
+            real[j] = swap;
+        }
+
+        // Próximo índice com os bits invertidos
+        uint8_t bit = FFT_POINTS / 2;
+        while (j & bit) {
+            j ^= bit;
+            bit >>= 1;
+        }
+        j |= bit;
+    }
+
+    // Borboletas, dividindo o resultado por 2 a cada estágio para que nunca
+    // transborde (o resultado final fica dividido por N). Cada twiddle é lido
+    // uma vez por estágio
+    for (uint8_t half = 1; half < FFT_POINTS; half *= 2) {
+        uint8_t step = FFT_POINTS / 2 / half;
+        for (uint8_t k = 0; k < half; ++k) {
+            int16_t cosine = pgm_read_word(&sine[k * step + FFT_POINTS / 4]);
+            int16_t minus_sine = -(int16_t) pgm_read_word(&sine[k * step]);
+
+            for (uint8_t a = k; a < FFT_POINTS; a += 2 * half) {
+                uint8_t b = a + half;
+                int16_t tr = multiply(real[b], cosine) - multiply(imaginary[b], minus_sine);
+                int16_t ti = multiply(real[b], minus_sine) + multiply(imaginary[b], cosine);
+                int16_t ar = real[a];
+                int16_t ai = imaginary[a];
+                real[a] = ((int32_t) ar + tr) >> 1;
+                imaginary[a] = ((int32_t) ai + ti) >> 1;
+                real[b] = ((int32_t) ar - tr) >> 1;
+                imaginary[b] = ((int32_t) ai - ti) >> 1;
+            }
+        }
+    }
+
+    // Magnitude das frequências até a de Nyquist (exclusive)
+    for (uint8_t i = 0; i < FFT_BINS; ++i) {
+        int32_t r = real[i];
+        int32_t m = imaginary[i];
+        block[i] = isqrt(r * r + m * m);
+    }
+}
@@ -0,0 +1,61 @@
+#include "linearize.h"
+
+#ifdef __AVR__
+#include <avr/pgmspace.h>
+#else
+// No host, as tabelas ficam na memória comum
+#define PROGMEM
+#define pgm_read_word(address) (*(const uint16_t *) (address))
+#endif
+
+
+// Pontos das tabelas, calculados pela equação do parâmetro B:
+//
+//     R = 10000 * raw / (1024 - raw)
+//     T = 1 / (1/298,15 + ln(R/10000) / B) - 273,15
+//
+// arredondada para centésimos de grau e limitada a [-55 °C, 150 °C]
+static const int16_t tables[LINEARIZE_TABLES_NUMBER - 1][LINEARIZE_SEGMENTS + 1] PROGMEM = {
+    [LINEARIZE_NTC_3950 - 1] = {
+        15000, 15000, 12932, 11274, 10160, 9326, 8661, 8107,
+        7633, 7218, 6849, 6515, 6211, 5930, 5669, 5425,
+        5196, 4979, 4772, 4575, 4387, 4205, 4030, 3860,
+        3696, 3536, 3379, 3226, 3077, 2929, 2784, 2641,
+        2500, 2360, 2221, 2083, 1945, 1807, 1670, 1532,
+        1393, 1253, 1113, 970, 825, 678, 528, 375,
+        217, 54, -114, -288, -471, -663, -867, -1084,
+        -1318, -1575, -1859, -2182, -2560, -3023, -3637, -4603,
+        -5500,
+    },
+    [LINEARIZE_NTC_3435 - 1] = {
+        15000, 15000, 15000, 13055, 11662, 10628, 9811, 9135,
+        8559, 8057, 7613, 7212, 6848, 6513, 6203, 5914,
+        5643, 5386, 5143, 4912, 4690, 4478, 4273, 4075,
+        3883, 3697, 3516, 3338, 3165, 2995, 2827, 2663,
+        2500, 2339, 2180, 2021, 1864, 1706, 1549, 1392,
+        1234, 1075, 916, 754, 590, 424, 255, 82,
+        -96, -278, -467, -662, -866, -1080, -1307, -1548,
+        -1808, -2091, -2405, -2760, -3174, -3680, -4346, -5386,
+        -5500,
+    },
+};
+
+
+int16_t linearize(uint8_t table, uint16_t raw) {
+    if (table == LINEARIZE_NONE || table >= LINEARIZE_TABLES_NUMBER) {
+        return raw;
+    }
+
+    // Segmento e posição dentro dele. O valor 1023 fica no último segmento,
+    // então o ponto seguinte sempre existe
+    const int16_t *points = tables[table - 1];
+    uint8_t segment = (raw >> LINEARIZE_SEGMENT_SHIFT) & (LINEARIZE_SEGMENTS - 1);
+    uint8_t fraction = raw & ((1 << LINEARIZE_SEGMENT_SHIFT) - 1);
+
+    int16_t start = pgm_read_word(&points[segment]);
+    int16_t end = pgm_read_word(&points[segment + 1]);
+
+    // A diferença entre dois pontos vezes a posição cabe em 16 bits (nas
+    // tabelas atuais, no máximo 2068 vezes 15)
+    return start + (int16_t) ((end - start) * fraction) / (1 << LINEARIZE_SEGMENT_SHIFT);
+}
@@ -1,165 +1,1518 @@
 #include <avr/interrupt.h>
 #include <avr/io.h>
+#include <avr/power.h>
 #include <stdbool.h>
+#include <util/atomic.h>
+
+#include "boot.h"
+#include "config.h"
+#include "debug.h"
+#include "detector.h"
+#include "eeprom_log.h"
+#include "fft.h"
+#include "linearize.h"
+#include "log.h"
+#include "median.h"
+#include "meter.h"
+#include "pid.h"
+#include "pipeline.h"
+#include "power.h"
+#include "reg.h"
+#include "ring.h"
+#include "scheduler.h"
+#include "timebase.h"
+#include "twi.h"
+#include "usart.h"
+
+#ifdef BENCHMARK
+#include "benchmark.h"
+#endif
 
 /**
- * Novamente, temos que escolher o prescaler do Timer0 adequadamente. Foi utilizado
- * o valor de 64 pois é o menor prescaler para o qual `CPU_CLOCK / 64 / SAMPLING_RATE - 1`
- * cabe em 8 bits. Os dois outros prescalers menores, 1 e 8, levam a um valor de
- * TOP que estoura a capacidade do contador.
+ * Novamente, temos que escolher o prescaler do Timer0 adequadamente. Como a taxa
+ * de amostragem agora faz parte da configuração (`config.h`), o prescaler é
+ * escolhido em `sampling_set_rate`: é utilizado o menor prescaler para o qual
+ * `CPU_CLOCK / PRESCALER / config.sampling_rate - 1` cabe em 8 bits. Para a
+ * taxa padrão de 125 Hz, esse é o prescaler de 64.
+ *
+ * O auto-trigger do ADC é disparado pela borda de subida da flag OCF0A. Antes,
+ * a interrupção de compare match do Timer0 era habilitada com uma rotina vazia
+ * só para que o hardware limpasse essa flag ao atendê-la, o que custava a
+ * resposta à interrupção, o `jmp` do vetor, o prólogo/epílogo gerado pelo
+ * compilador e o `reti` a cada amostra. Agora a interrupção fica desabilitada
+ * e a própria rotina do ADC limpa a flag (um `ldi` e um `out`) logo no
+ * início. Isso exige que a conversão (216 ciclos) e a latência da interrupção
+ * caibam em um período de amostragem, senão a flag continua setada no
+ * próximo compare match e a conversão seguinte não é disparada. A taxa
+ * máxima (`SAMPLING_RATE_MAX`) é limitada para isso em `config.h`.
+ *
+ * No modo adaptativo (comando 'v1'), a atividade do sinal é estimada a cada
+ * janela de amostras (`pipeline_activity`), e a taxa é dobrada ou reduzida à
+ * metade, dentro dos limites configurados. Toda mudança de taxa durante a
+ * transmissão é informada no próprio stream por uma linha "#rate <Hz>",
+ * colocada entre a última amostra tomada na taxa anterior e a primeira tomada
+ * na nova, para que o host reconstrua o eixo do tempo.
+ *
+ * As interrupções só guardam o que receberam em filas SPSC (`ring.h`) e postam
+ * um evento para o escalonador (`scheduler.h`), cujas flags ficam em GPIOR0. O tratamento dos
+ * comandos e a transmissão das amostras são feitos no contexto principal, e a
+ * CPU dorme enquanto não há nada a fazer, em vez de ficar consultando as flags
+ * continuamente.
+ *
+ * Enquanto a transmissão está parada, as amostras podem ser salvas no log da
+ * EEPROM (`eeprom_log.h`), habilitado pelo comando 'l1', e lidas depois pelo
+ * comando 'd'. Com a transmissão parada e o log desabilitado, o Timer0 e o ADC
+ * ficam desligados, o que permite ao gerenciador de energia (`power.h`) colocar
+ * a CPU em power-down. Ela acorda quando chega um byte pela serial.
+ *
+ * As amostras também podem ser consultadas por um mestre I2C, pelo mapa de
+ * registradores da interface TWI escrava (`twi.h`), que funciona ao mesmo
+ * tempo que a serial. O mestre pode manter a amostragem ligada e alterar a
+ * configuração pelo próprio mapa.
+ *
+ * O tempo desde o vetor de reset até a primeira amostra colocada na fila de
+ * transmissão é medido pela base de tempo, que é iniciada em `.init3`, antes mesmo da inicialização
+ * das variáveis globais. Para reduzi-lo:
+ *
+ * - com a flag de auto-start na configuração, a amostragem começa logo na
+ *   inicialização, sem esperar o comando '1';
+ * - a configuração é restaurada da EEPROM, sem esperar comandos do host;
+ * - a primeira conversão é iniciada imediatamente ao ligar o ADC, em vez de
+ *   esperar o primeiro compare match do Timer0 (até um período inteiro de
+ *   amostragem).
+ *
+ * O tempo de start-up do oscilador após o reset (até 65 ms, definido pelos
+ * fuses SUT) acontece antes do vetor de reset e não é medido. Ele pode ser
+ * reduzido gravando os fuses SUT para o menor valor compatível com a fonte de
+ * alimentação.
+ *
+ * A entrada também pode ser utilizada para controle, com o comando 'c1': um
+ * controlador PID (`pid.h`) é executado na própria interrupção do ADC, logo
+ * após a leitura, e a sua saída é escrita no duty cycle de um PWM no pino
+ * OC2A (PB3), gerado pelo Timer2 em fast PWM com prescaler de 1 (3,9 kHz). O
+ * caminho da amostra até a saída não passa pela fila nem pelo escalonador,
+ * então o seu atraso não depende do contexto principal:
+ *
+ * - do compare match do Timer0 até o fim da conversão: 13,5 ciclos do ADC,
+ *   216 ciclos de CPU (a amostragem acontece nos primeiros 1,5);
+ * - até o início da interrupção: a latência da interrupção do ADC, limitada
+ *   pela política de aninhamento (`interrupts.h`);
+ * - até a escrita do OCR2A: o prólogo e o cálculo do PID, sem laços nem
+ *   divisões, então de duração constante;
+ * - até o novo duty cycle valer: o OCR2A só é atualizado no fim do período do
+ *   PWM, até 256 ciclos depois.
+ *
+ * Os três primeiros somados são medidos a cada amostra pelo TCNT0 no momento
+ * da escrita (o Timer0 recomeça do 0 no compare match que dispara a
+ * conversão), e o maior deles é informado pelo comando 's', em ciclos, com a
+ * resolução do prescaler do Timer0. Com o comando 't1', o stream passa a
+ * transmitir o setpoint, a medida e a saída de cada amostra.
+ *
+ * Para sensores não lineares (termistores, por exemplo), o stream pode
+ * transmitir o valor em unidades de engenharia, convertido por uma tabela na
+ * flash escolhida para cada canal com o comando 'u' (`linearize.h`). A
+ * conversão é feita no contexto principal, só para a serial: o log da EEPROM,
+ * o TWI e o controle continuam com o valor do ADC.
+ *
+ * Picos isolados (do chaveamento de relés, por exemplo) podem ser removidos
+ * por um filtro de mediana em cada canal (`median.h`), escolhido com o
+ * comando 'h'. O filtro é aplicado no contexto principal, logo que a amostra
+ * sai da fila, então o stream, o log, o TWI e o medidor de energia recebem as
+ * amostras filtradas. O controle e o espectro, que não passam pela fila,
+ * recebem as amostras originais.
+ *
+ * No modo de eventos (comando 'z1'), o stream transmite só os cruzamentos do
+ * nível médio de ADC0, com histerese, e os picos e vales entre eles
+ * (`detector.h`), com instantes interpolados entre as amostras. Os instantes
+ * são contados em períodos de amostragem desde o início do modo ou desde o
+ * último aviso "#rate", pelo número de sequência que a interrupção do ADC
+ * coloca em cada amostra, então as amostras descartadas na fila não atrasam
+ * a contagem. Com o filtro de mediana, todos os instantes ficam atrasados
+ * (n - 1) / 2 amostras.
+ *
+ * No modo de medidor de energia (comando 'm1'), a interrupção do ADC alterna
+ * a entrada entre a tensão (ADC0) e a corrente (ADC1) a cada conversão, e as
+ * amostras vão para o medidor (`meter.h`), que transmite um registro por
+ * segundo com a tensão e a corrente eficazes, a potência ativa e a energia,
+ * em vez das amostras. A entrada da próxima conversão é escolhida na própria
+ * interrupção, antes do próximo compare match. Cada canal tem metade da taxa
+ * de amostragem configurada.
+ *
+ * No modo de espectro (comando 'f1'), a interrupção do ADC junta as amostras
+ * de ADC0 em blocos de `FFT_POINTS`, sem passar pela fila, e o contexto
+ * principal transmite as magnitudes da FFT de cada bloco (`fft.h`) em uma
+ * linha. São dois blocos: enquanto a FFT de um é calculada e transmitida, o
+ * outro é preenchido. Caso a FFT não termine antes de o próximo bloco ficar
+ * completo, esse bloco é descartado e contado, e é informado pelo comando
+ * 's'.
+ *
+ * No modo de histograma (comando 'b1'), a interrupção do ADC conta cada
+ * amostra de ADC0 na sua faixa de valores, sem passar pela fila, e o
+ * histograma é transmitido pelo comando 'q' ou a cada período configurado.
+ * As faixas têm largura de potência de 2 (comando 'j'), então a faixa é
+ * obtida por um deslocamento, e os contadores são de 32 bits saturados, o que
+ * cabe com folga entre duas conversões na maior taxa do ADC. Os contadores
+ * ocupam a mesma memória que os blocos do espectro, então os dois modos não
+ * funcionam ao mesmo tempo, e ligar um desliga o outro. Como a transmissão, o
+ * modo não é salvo na configuração.
+ *
+ * Um host que começa a ler o stream no meio não sabe como interpretá-lo. Por
+ * isso, o canal de dados recebe um cabeçalho "#stream", com a versão do
+ * formato, a taxa de amostragem, os canais, a referência do ADC, a
+ * identificação da calibração (comando 'I') e a codificação das linhas
+ * seguintes:
+ *
+ *     #stream v=1 r=125 c=0 ref=aref cal=0 enc=raw
+ *
+ * O cabeçalho é transmitido no início da transmissão, depois de qualquer
+ * comando ou escrita do TWI que altere um desses campos, e a cada 256
+ * registros do stream (amostras, linhas de telemetria, registros do
+ * medidor, espectros, eventos ou histogramas). As mudanças de taxa continuam
+ * informadas só pela linha "#rate", na posição exata do stream, que atualiza
+ * a taxa do último cabeçalho.
+ *
+ * Mensagens de diagnóstico não passam pela serial do stream. No ambiente
+ * `debug`, elas saem por uma serial de depuração no pino OC1B (`debug.h`),
+ * como registros binários do log (`log.h`): a interrupção do ADC registra as
+ * amostras e os blocos descartados, e o contexto principal, o boot, os
+ * comandos executados e as mudanças de taxa. O texto é reconstituído no host
+ * por `tools/decode.c`.
+ *
+ * O custo de cada interrupção pode ser medido no simavr com `tools/sim.c`, e o
+ * processamento das amostras (`pipeline.h`) pode ser testado com traços
+ * gravados por `tools/replay.c`, no host ou no simavr.
  */
 
 
-// Frequência da CPU (em Hz)
-#define CPU_CLOCK 1000000
+// Amostra lida pelo ADC, com o canal (a entrada do ADC), a saída do controle
+// calculada para ela e o número de sequência da conversão
+struct sample {
+    uint16_t value;
+    uint8_t channel;
+    uint8_t output;
+    uint8_t sequence;
+};
+
+// Fila das amostras lidas pelo ADC e ainda não transmitidas
+RING_DEFINE(sample_ring, struct sample, 8)
+struct sample_ring samples;
+
+// Quantidade de amostras descartadas por falta de espaço nas filas, desde a
+// última consulta das estatísticas
+volatile uint16_t samples_dropped = 0;
+
+// Filtro de mediana de cada canal
+struct median medians[CHANNELS_NUMBER];
+
+// Número de sequência da próxima conversão
+uint8_t sample_sequence = 0;
+
+// Controlador PID, executado na interrupção do ADC enquanto o controle está
+// ligado. O setpoint e os ganhos só são alterados com as interrupções
+// desabilitadas
+struct pid controller;
+volatile bool control_running = false;
+
+// Maior quantidade de ticks do Timer0 entre o compare match que disparou a
+// conversão e a escrita da saída, desde a última consulta das estatísticas
+volatile uint8_t control_max_latency = 0;
+
+// Indica se o medidor de energia está ligado, e a entrada do ADC selecionada
+// (a da conversão em andamento)
+volatile bool meter_running = false;
+volatile uint8_t adc_channel = 0;
 
-// Taxa de amostragem do sinal analógico (em Hz)
-#define SAMPLING_RATE 125
+// Indica se as amostras de ADC0 são juntadas em blocos para o espectro
+volatile bool spectrum_running = false;
 
-// Baud rate da comunicação serial (em Hz)
-#define BAUD_RATE 9600
+// Faixa de valores de 10 bits dividida pelo histograma, e a maior
+// quantidade de faixas (com a menor largura, de 16 LSB)
+#define HISTOGRAM_RANGE 1024
+#define HISTOGRAM_SHIFT_MIN 4
+#define HISTOGRAM_BINS_MAX (HISTOGRAM_RANGE >> HISTOGRAM_SHIFT_MIN)
 
+// Memória compartilhada pelos modos de espectro e de histograma. Os blocos do
+// espectro são o que está sendo preenchido pela interrupção do ADC e o que
+// está com o contexto principal, enquanto `spectrum_busy`
+union {
+    uint16_t spectrum[2][FFT_POINTS];
+    uint32_t histogram[HISTOGRAM_BINS_MAX];
+} buffers;
 
-// Interrupção que é disparada toda vez que o timer atinge TOP
-ISR(TIMER0_COMPA_vect) { }
+// Indica se as amostras de ADC0 são contadas no histograma, a largura das
+// faixas (em potência de 2), e as amostras de ADC0 que faltam para o fim do
+// período
+volatile bool histogram_running = false;
+volatile uint8_t histogram_shift;
+volatile uint32_t histogram_countdown;
+volatile uint32_t histogram_period_samples;
+
+volatile uint8_t spectrum_fill = 0;
+volatile uint8_t spectrum_count = 0;
+volatile bool spectrum_busy = false;
+
+// Quantidade de blocos descartados desde a última consulta das estatísticas
+volatile uint16_t spectrum_dropped = 0;
+
+// Recalcula o período da transmissão do histograma, em amostras de ADC0, na
+// taxa de amostragem atual. No medidor de energia, ADC0 tem metade da taxa
+void histogram_set_period(void) {
+    uint32_t samples = (uint32_t) config.histogram_period * config.sampling_rate;
+    if (meter_running) {
+        samples /= 2;
+    }
+    ATOMIC_BLOCK(ATOMIC_FORCEON) {
+        histogram_period_samples = samples;
+        histogram_countdown = samples;
+    }
+}
+
+// Transmite o histograma no canal de dados: o aviso "#histogram <largura>" e
+// os contadores de todas as faixas, separados por vírgulas em uma linha. Cada
+// contador é lido (e zerado, com `clear`) sem interrupções, então nenhuma
+// amostra é perdida entre a leitura e a limpeza. Retorna falso, sem
+// transmitir nada, caso o modo esteja desligado
+bool histogram_dump(bool clear) {
+    if (!histogram_running) {
+        return false;
+    }
+    uint8_t shift = histogram_shift;
+    USART_transmit_report(USART_CHANNEL_DATA, "histogram", 1u << shift);
+    for (uint8_t i = 0; i < (HISTOGRAM_RANGE >> shift); ++i) {
+        uint32_t count;
+        ATOMIC_BLOCK(ATOMIC_FORCEON) {
+            count = buffers.histogram[i];
+            if (clear) {
+                buffers.histogram[i] = 0;
+            }
+        }
+        if (i != 0) {
+            USART_transmit(USART_CHANNEL_DATA, ',');
+        }
+        USART_transmit_decimal(USART_CHANNEL_DATA, count);
+    }
+    USART_transmit(USART_CHANNEL_DATA, '\r');
+    USART_transmit(USART_CHANNEL_DATA, '\n');
+    return true;
+}
 
+// Tensão de referência do ADC, e o seu nome no cabeçalho do stream
+#define ADC_REFERENCE ADC_REFERENCE_AREF
+#define ADC_REFERENCE_NAME "aref"
 
-// Flag que indica se uma nova leitura foi realizada
-volatile bool has_new_sample = false;
-// Variável para salvar o último valor gerado pelo ADC
-volatile uint16_t sample = 0;
+// Configuração do ADMUX: tensão de referência `ADC_REFERENCE`, resultado
+// right-adjusted no registrador ADC e leitura na entrada `channel`
+#define ADMUX_CONFIG(channel) REG_CONFIG(ADMUX,                                 \
+    REG_FIELD(ADMUX_REFS, ADC_REFERENCE),                                       \
+    REG_FIELD(ADMUX_ADLAR, 0),                                                  \
+    REG_FIELD(ADMUX_MUX, channel))
 
 // Interrupção que é disparada quando o ADC completa a conversão
 ISR(ADC_vect) {
-    // Informa que há um novo valor que pode ser transimitido
-    has_new_sample = true;
+    // Limpa a flag de compare match do Timer0, para que o próximo compare
+    // match gere uma nova borda de subida e dispare a próxima conversão
+    TIFR0 = 1<<OCF0A;
     // Realiza a leitura do valor convertido pelo ADC
-    sample = ADC;
+    uint8_t channel = adc_channel;
+    struct sample sample = {
+        .value = ADC, .channel = channel, .output = 0, .sequence = sample_sequence++
+    };
+
+    // A saída do controle é atualizada antes de qualquer outra coisa
+    if (control_running && channel == 0) {
+        sample.output = pid_update(&controller, sample.value);
+        OCR2A = sample.output;
+
+        uint8_t latency = TCNT0;
+        if (latency > control_max_latency) {
+            control_max_latency = latency;
+        }
+    }
+
+    // No medidor de energia, a próxima conversão é da outra entrada. Fora
+    // dele, a entrada volta a ser ADC0
+    uint8_t next = meter_running ? channel ^ 1 : 0;
+    if (next != channel) {
+        adc_channel = next;
+        ADMUX = next ? ADMUX_CONFIG(1) : ADMUX_CONFIG(0);
+    }
+
+    // No modo de histograma, as amostras de ADC0 só são contadas na sua
+    // faixa. O contador satura em vez de dar a volta. O período também é
+    // contado nas amostras de ADC0
+    if (histogram_running) {
+        if (channel == 0) {
+            if (histogram_period_samples != 0 && --histogram_countdown == 0) {
+                histogram_countdown = histogram_period_samples;
+                scheduler_post(EVENT_HISTOGRAM);
+            }
+            uint32_t *counter = &buffers.histogram[sample.value >> histogram_shift];
+            if (*counter != UINT32_MAX) {
+                *counter += 1;
+            }
+            return;
+        }
+    }
+
+    // No modo de espectro, as amostras de ADC0 vão para o bloco atual. Um
+    // bloco completo é entregue ao contexto principal caso ele já tenha
+    // terminado o anterior
+    if (spectrum_running && channel == 0) {
+        uint8_t count = spectrum_count;
+        buffers.spectrum[spectrum_fill][count] = sample.value;
+        count += 1;
+        if (count == FFT_POINTS) {
+            count = 0;
+            if (!spectrum_busy) {
+                spectrum_busy = true;
+                spectrum_fill ^= 1;
+                scheduler_post(EVENT_BLOCK);
+            } else {
+                spectrum_dropped += 1;
+                LOG1(BLOCK_DROPPED, spectrum_dropped);
+            }
+        }
+        spectrum_count = count;
+        return;
+    }
+
+    if (!sample_ring_push(&samples, sample)) {
+        samples_dropped += 1;
+        LOG2(SAMPLE_DROPPED, sample.sequence, sample.value);
+    }
+    // Informa que há um novo valor que pode ser transimitido
+    scheduler_post(EVENT_SAMPLE);
+}
+
+
+// Inicia a base de tempo logo após o vetor de reset, antes da inicialização
+// das variáveis globais, para que o tempo de boot seja medido desde o início
+__attribute__((naked, used, section(".init3")))
+void boot_timebase_init(void) {
+    timebase_init();
 }
 
+// Ciclos desde o reset até o fim da inicialização
+uint16_t boot_ready_cycles = 0;
+// Ciclos até a primeira amostra colocada na fila de transmissão (não até a
+// sua saída no UDR0), contados desde o reset quando a transmissão começa na
+// inicialização (auto-start), ou desde o primeiro comando '1'
+uint32_t boot_first_queued_cycles = 0;
+// Momento do primeiro comando '1', ou 0 (o reset) com o auto-start
+uint32_t boot_transmit_start = 0;
+// Indica se alguma amostra já foi transmitida desde o reset
+bool boot_has_transmitted = false;
+
+
+// Indica se os valores devem ser transmitidos pela serial
+bool should_transmit = false;
+
+// Indica se o mestre do TWI pediu que a amostragem fique ligada
+bool twi_sampling = false;
+
+// Quantidade de amostras lidas desde a última consulta das estatísticas
+uint32_t samples_number = 0;
+
+// Bits CS02:0 do TCCR0B para a taxa de amostragem configurada
+uint8_t sampling_clock_select = 0;
 
-// Flag que indica se os valores devem ser transmitidos pela serial
-volatile bool should_transmit = false;
+// Prescalers do Timer0, na ordem dos valores dos bits CS02:0 (a partir de 1)
+const uint16_t timer0_prescalers[5] = { 1, 8, 64, 256, 1024 };
 
-// Interrupção que é disparada quando é recebido um byte pela serial
-ISR(USART_RX_vect) {
-    switch (UDR0) {
-        case '0':
-            // Ao receber '0' pela serial, transmissão é parada
-            should_transmit = false;
+// Configura o Timer0 para a taxa de amostragem `rate` (em Hz), utilizando o
+// menor prescaler para o qual o TOP cabe em 8 bits. Retorna falso caso a taxa
+// esteja fora dos limites
+bool sampling_set_rate(uint16_t rate) {
+    if (rate < SAMPLING_RATE_MIN || rate > SAMPLING_RATE_MAX) {
+        return false;
+    }
+
+    for (uint8_t i = 0; i < 5; ++i) {
+        uint32_t ticks = CPU_CLOCK / timer0_prescalers[i] / rate;
+        if (ticks <= 256) {
+            OCR0A = ticks - 1;
+            sampling_clock_select = i + 1;
             break;
+        }
+    }
+
+    // Caso a amostragem esteja em andamento, o novo prescaler passa a valer
+    // imediatamente. O timer é zerado para não passar do novo TOP, então o
+    // intervalo até a próxima amostra é o da nova taxa mais o tempo desde a
+    // última
+    if (TCCR0B != 0) {
+        TCNT0 = 0;
+        TCCR0B = sampling_clock_select;
+    }
+
+    config.sampling_rate = rate;
+    return true;
+}
+
+// Configuração do ADCSRA: interrupção ao fim da conversão, prescaler de 16 e
+// auto-trigger habilitado. `enable` liga o ADC e `start` inicia uma conversão
+#define ADCSRA_CONFIG(enable, start) REG_CONFIG(ADCSRA,                         \
+    REG_FIELD(ADCSRA_ADEN, enable),                                             \
+    REG_FIELD(ADCSRA_ADSC, start),                                              \
+    REG_FIELD(ADCSRA_ADATE, 1),                                                 \
+    REG_FIELD(ADCSRA_ADIE, 1),                                                  \
+    REG_FIELD(ADCSRA_ADPS, ADC_PRESCALER_16))
+
+// Indica se há uma mudança de taxa a informar no stream, e quantas amostras
+// tomadas na taxa anterior ainda faltam ser processadas antes do aviso
+bool rate_report_pending = false;
+uint8_t rate_report_countdown;
+
+// Altera a taxa de amostragem, informando a mudança no stream depois das
+// `old_samples` amostras ainda não processadas, que foram tomadas na taxa
+// anterior
+void sampling_change_rate(uint16_t rate, uint8_t old_samples) {
+    if (rate == config.sampling_rate || !sampling_set_rate(rate)) {
+        return;
+    }
+    LOG2(RATE_CHANGE, config.sampling_rate, rate);
+    pipeline_activity_reset();
+    if (meter_running) {
+        meter_set_rate(rate);
+    }
+    // O bloco do espectro recomeça, com todas as amostras na nova taxa, e o
+    // período do histograma passa a ser contado na nova taxa
+    spectrum_count = 0;
+    histogram_set_period();
+    rate_report_pending = true;
+    rate_report_countdown = old_samples;
+}
+
+// Ajusta a taxa de amostragem à atividade do sinal, no modo adaptativo.
+// `old_samples` é a quantidade de amostras tomadas depois de `sample`
+void sampling_adapt(uint16_t sample, uint8_t old_samples) {
+    if (!(config.flags & CONFIG_ADAPTIVE) || meter_running) {
+        return;
+    }
+
+    int8_t step = pipeline_activity(sample, ADAPTIVE_HIGH, ADAPTIVE_LOW);
+    if (step == 0) {
+        return;
+    }
+
+    uint16_t rate = step > 0 ? config.sampling_rate * 2 : config.sampling_rate / 2;
+    if (rate > config.adaptive_max) {
+        rate = config.adaptive_max;
+    }
+    if (rate < config.adaptive_min) {
+        rate = config.adaptive_min;
+    }
+    sampling_change_rate(rate, old_samples);
+}
+
+// Indica se o Timer0 e o ADC estão ligados
+bool sampling_running = false;
+
+// Liga o Timer0 e o ADC, iniciando a amostragem
+void sampling_start(void) {
+    power_require(POWER_TIMER0);
+
+    // Timer começa em 0, com o prescaler da taxa configurada (valor dos bits
+    // CS02:0, os únicos não nulos de TCCR0B)
+    TCNT0 = 0;
+    TCCR0B = sampling_clock_select;
+
+    // Habilita o ADC (mesma configuração de `main`, com o bit ADEN setado) e
+    // já inicia a primeira conversão, sem esperar o primeiro compare match
+    ADCSRA = ADCSRA_CONFIG(1, 1);
+}
+
+// Desliga o Timer0 e o ADC, liberando a CPU para dormir em power-down
+void sampling_stop(void) {
+    // Para o clock do timer
+    TCCR0B = REG_CONFIG(TCCR0B, REG_FIELD(TCCR0B_CS, TIMER_CLOCK_STOPPED));
+
+    // Desabilita o ADC
+    ADCSRA = ADCSRA_CONFIG(0, 0);
 
-        case '1':
-            // Ao receber '1' pela serial, transmissão é realizada
-            should_transmit = true;
+    power_release(POWER_TIMER0);
+}
+
+// Copia o setpoint e os ganhos da configuração para o controlador, de uma vez
+// só em relação à interrupção do ADC
+void control_apply_config(void) {
+    ATOMIC_BLOCK(ATOMIC_FORCEON) {
+        controller.setpoint = config.setpoint;
+        controller.kp = config.kp;
+        controller.ki = config.ki;
+        controller.kd = config.kd;
+    }
+}
+
+// Liga o PWM no pino OC2A e o controle, com a saída começando em 0
+void control_start(void) {
+    power_timer2_enable();
+    power_require(POWER_TIMER2);
+
+    // Fast PWM não invertido no OC2A, com prescaler de 1 (TOP 0xFF)
+    OCR2A = 0;
+    TCNT2 = 0;
+    TCCR2A = REG_CONFIG(TCCR2A,
+        REG_FIELD(TCCR2A_COM2A, TIMER_COM_CLEAR),
+        REG_FIELD(TCCR2A_WGM, TIMER2_WGM_FAST_PWM));
+    TCCR2B = REG_CONFIG(TCCR2B, REG_FIELD(TCCR2B_CS, TIMER2_CLOCK_1));
+
+    // O termo derivativo parte da última conversão do ADC (0 caso ainda não
+    // tenha havido nenhuma)
+    control_apply_config();
+    ATOMIC_BLOCK(ATOMIC_FORCEON) {
+        pid_reset(&controller, ADC, 0);
+        control_running = true;
+    }
+}
+
+// Desliga o controle e o PWM. O pino OC2A volta a ser controlado pelo PORTB,
+// que o mantém em 0
+void control_stop(void) {
+    control_running = false;
+
+    TCCR2A = REG_CONFIG(TCCR2A, REG_FIELD(TCCR2A_COM2A, TIMER_COM_DISCONNECTED));
+    TCCR2B = REG_CONFIG(TCCR2B, REG_FIELD(TCCR2B_CS, TIMER2_CLOCK_STOPPED));
+
+    power_release(POWER_TIMER2);
+    power_timer2_disable();
+}
+
+// Liga ou desliga o controle de acordo com a configuração
+void control_update(void) {
+    bool enabled = config.flags & CONFIG_CONTROL;
+    if (enabled && !control_running) {
+        control_start();
+    } else if (!enabled && control_running) {
+        control_stop();
+    }
+}
+
+// Liga ou desliga o medidor de energia de acordo com a configuração. A
+// energia acumulada é zerada a cada vez que ele é ligado
+void meter_update(void) {
+    bool enabled = config.flags & CONFIG_METER;
+    if (enabled && !meter_running) {
+        meter_reset(config.sampling_rate);
+    }
+    if (enabled != meter_running) {
+        meter_running = enabled;
+        histogram_set_period();
+    }
+}
+
+// Liga ou desliga o modo de espectro de acordo com a configuração. O bloco é
+// preenchido desde o início. O histograma, que ocupa a mesma memória, é
+// desligado
+void spectrum_update(void) {
+    bool enabled = config.flags & CONFIG_SPECTRUM;
+    if (enabled && !spectrum_running) {
+        histogram_running = false;
+        spectrum_count = 0;
+    }
+    spectrum_running = enabled;
+}
+
+// Liga ou desliga o modo de histograma, com os contadores zerados. Como os
+// contadores ocupam a memória dos blocos do espectro, o espectro é desligado
+void histogram_enable(bool enabled) {
+    histogram_running = false;
+    if (!enabled) {
+        return;
+    }
+    config.flags &= ~CONFIG_SPECTRUM;
+    spectrum_update();
+
+    for (uint8_t i = 0; i < HISTOGRAM_BINS_MAX; ++i) {
+        buffers.histogram[i] = 0;
+    }
+    histogram_shift = config.histogram_shift;
+    histogram_set_period();
+    histogram_running = true;
+}
+
+// Liga ou desliga a amostragem, que é necessária enquanto as amostras são
+// transmitidas, salvas no log da EEPROM, lidas pelo mestre do TWI ou
+// utilizadas pelo controle, pelo medidor de energia, pelo espectro ou pelo
+// histograma
+void sampling_update(void) {
+    bool needed = should_transmit || twi_sampling || histogram_running
+        || (config.flags & (CONFIG_LOGGING | CONFIG_CONTROL | CONFIG_METER | CONFIG_SPECTRUM));
+    if (needed && !sampling_running) {
+        sampling_start();
+    } else if (!needed && sampling_running) {
+        sampling_stop();
+    }
+    sampling_running = needed;
+
+    // Ao voltar a transmitir, o registro incompleto do log é fechado
+    if (should_transmit) {
+        eeprom_log_flush();
+    }
+}
+
+// Versão do formato do stream, informada no cabeçalho. Deve ser incrementada a
+// cada mudança no formato das linhas ou do próprio cabeçalho
+#define STREAM_FORMAT_VERSION 1
+
+// Codificações das linhas do stream, na ordem de `stream_encodings`
+#define STREAM_RAW 0
+#define STREAM_UNITS 1
+#define STREAM_TELEMETRY 2
+#define STREAM_METER 3
+#define STREAM_SPECTRUM 4
+#define STREAM_EVENTS 5
+#define STREAM_HISTOGRAM 6
+
+// Nomes das codificações no cabeçalho
+const char *const stream_encodings[] = {
+    [STREAM_RAW] = "raw",
+    [STREAM_UNITS] = "units",
+    [STREAM_TELEMETRY] = "telemetry",
+    [STREAM_METER] = "meter",
+    [STREAM_SPECTRUM] = "spectrum",
+    [STREAM_EVENTS] = "events",
+    [STREAM_HISTOGRAM] = "histogram",
+};
+
+// Campos variáveis do cabeçalho do stream
+struct stream_header {
+    uint16_t rate;
+    uint16_t calibration_id;
+    uint8_t encoding;
+    bool meter;
+};
+
+// Último cabeçalho transmitido, e a quantidade de registros do stream
+// transmitidos desde então (o cabeçalho é repetido quando ela dá a volta)
+struct stream_header stream_header;
+uint8_t stream_records = 0;
+
+// Codificação atual das linhas do stream, na mesma ordem de prioridade em que
+// os modos desviam as amostras (ver `ADC_vect` e `handle_sample`)
+uint8_t stream_encoding(void) {
+    if (histogram_running) {
+        return STREAM_HISTOGRAM;
+    }
+    if (spectrum_running) {
+        return STREAM_SPECTRUM;
+    }
+    if (meter_running) {
+        return STREAM_METER;
+    }
+    if (config.flags & CONFIG_EVENTS) {
+        return STREAM_EVENTS;
+    }
+    if (config.flags & CONFIG_TELEMETRY) {
+        return STREAM_TELEMETRY;
+    }
+    if (config.linearize[0] != LINEARIZE_NONE) {
+        return STREAM_UNITS;
+    }
+    return STREAM_RAW;
+}
+
+// Transmite o cabeçalho do stream caso algum campo tenha mudado desde o último
+// (ou sempre, com `force`). Enquanto uma mudança de taxa não foi informada no
+// stream, o cabeçalho mantém a taxa das amostras ainda não transmitidas
+void stream_header_update(bool force) {
+    struct stream_header header = {
+        .rate = rate_report_pending ? stream_header.rate : config.sampling_rate,
+        .calibration_id = config.calibration_id,
+        .encoding = stream_encoding(),
+        .meter = meter_running,
+    };
+    bool changed = header.rate != stream_header.rate
+        || header.calibration_id != stream_header.calibration_id
+        || header.encoding != stream_header.encoding
+        || header.meter != stream_header.meter;
+    if (!should_transmit || !(force || changed)) {
+        return;
+    }
+    stream_header = header;
+    stream_records = 0;
+
+    USART_transmit_string(USART_CHANNEL_DATA, "#stream v=");
+    USART_transmit_decimal(USART_CHANNEL_DATA, STREAM_FORMAT_VERSION);
+    USART_transmit_string(USART_CHANNEL_DATA, " r=");
+    USART_transmit_decimal(USART_CHANNEL_DATA, header.rate);
+    USART_transmit_string(USART_CHANNEL_DATA, header.meter ? " c=0,1" : " c=0");
+    USART_transmit_string(USART_CHANNEL_DATA, " ref=" ADC_REFERENCE_NAME " cal=");
+    USART_transmit_decimal(USART_CHANNEL_DATA, header.calibration_id);
+    USART_transmit_string(USART_CHANNEL_DATA, " enc=");
+    USART_transmit_string(USART_CHANNEL_DATA, stream_encodings[header.encoding]);
+    USART_transmit(USART_CHANNEL_DATA, '\r');
+    USART_transmit(USART_CHANNEL_DATA, '\n');
+}
+
+// Conta um registro transmitido no stream, repetindo o cabeçalho a cada 256
+void stream_header_tick(void) {
+    stream_records += 1;
+    if (stream_records == 0) {
+        stream_header_update(true);
+    }
+}
+
+// Ciclos de espera entre o aviso "#dump" e a troca do baud rate (100 ms)
+#define DUMP_SWITCH_CYCLES (CPU_CLOCK / 10)
+
+// Dígitos hexadecimais dos registros do log
+const uint8_t hex_digits[16] = {
+    '0', '1', '2', '3', '4', '5', '6', '7',
+    '8', '9', 'a', 'b', 'c', 'd', 'e', 'f',
+};
+
+// Transmite o log da EEPROM, do registro mais antigo ao mais recente
+void dump_log(void) {
+#ifdef MULTIDROP
+    // No barramento, o log não é transmitido (ver `usart.h`)
+    USART_transmit_report(USART_CHANNEL_CONTROL, "dump", 0);
+    return;
+#endif
+
+    // O registro atual é fechado, e a escrita na EEPROM é concluída antes da
+    // leitura
+    eeprom_log_flush();
+    while (eeprom_log_busy()) { }
+
+    // Avisa o host, no baud rate atual, quantos registros serão transmitidos
+    // em `DUMP_BAUD_RATE` (as posições sem registro válido são omitidas)
+    uint8_t record[EEPROM_LOG_RECORD_SIZE];
+    uint8_t valid = 0;
+    for (uint8_t i = 0; i < EEPROM_LOG_RECORDS; ++i) {
+        if (eeprom_log_read(i, record)) {
+            valid += 1;
+        }
+    }
+    USART_transmit_report(USART_CHANNEL_CONTROL, "dump", valid);
+    USART_flush();
+
+    // Dá tempo ao host para trocar o baud rate
+    uint32_t start = timebase_now32();
+    while (timebase_now32() - start < DUMP_SWITCH_CYCLES) { }
+
+    // Cada registro é transmitido no canal de dados em uma linha, com os
+    // bytes como estão na EEPROM (ver `eeprom_log.h`) em hexadecimal, para
+    // que nenhum deles seja confundido com um marcador de canal. O
+    // "#dump_end" ainda sai em `DUMP_BAUD_RATE`, e o baud rate só volta ao
+    // normal depois que ele sai do shift register
+    USART_set_baud_rate(DUMP_BAUD_RATE);
+    for (uint8_t i = 0; i < EEPROM_LOG_RECORDS; ++i) {
+        if (!eeprom_log_read(i, record)) {
+            continue;
+        }
+        for (uint8_t j = 0; j < EEPROM_LOG_RECORD_SIZE; ++j) {
+            USART_transmit(USART_CHANNEL_DATA, hex_digits[record[j] >> 4]);
+            USART_transmit(USART_CHANNEL_DATA, hex_digits[record[j] & 0xF]);
+        }
+        USART_transmit(USART_CHANNEL_DATA, '\r');
+        USART_transmit(USART_CHANNEL_DATA, '\n');
+    }
+    USART_transmit_report(USART_CHANNEL_CONTROL, "dump_end", valid);
+    USART_flush();
+
+    USART_set_baud_rate(BAUD_RATE);
+}
+
+// Instante da última amostra, em períodos de amostragem desde o início do
+// modo de eventos ou do último aviso de mudança de taxa, e o seu número de
+// sequência
+uint32_t sample_time = 0;
+uint8_t last_sequence = 0;
+
+// Recomeça a detecção de eventos e a contagem do tempo
+void events_reset(void) {
+    detector_reset(config.events_middle, config.events_hysteresis);
+    sample_time = 0;
+}
+
+// Passa uma amostra para a detecção de eventos, transmitindo os eventos
+// encontrados
+void events_sample(struct sample sample) {
+    struct detector_event events[DETECTOR_EVENTS_MAX];
+    uint8_t n = detector_add(sample_time, sample.value, events);
+    if (!should_transmit) {
+        return;
+    }
+
+    for (uint8_t i = 0; i < n; ++i) {
+        uint8_t chars[DETECTOR_EVENT_MAX];
+        uint8_t length = detector_format(&events[i], chars);
+        for (uint8_t j = 0; j < length; ++j) {
+            USART_transmit(USART_CHANNEL_DATA, chars[j]);
+        }
+        stream_header_tick();
+    }
+}
+
+// Comando sendo recebido ('\0' quando nenhum), o seu argumento decimal, e se
+// o argumento passou de 65535 (o comando é descartado no fim da linha)
+uint8_t command = '\0';
+uint16_t command_argument = 0;
+bool command_overflow = false;
+
+// Executa um comando com argumento, recebido por completo
+void execute_command(void) {
+    LOG2(COMMAND, command, command_argument);
+
+    switch (command) {
+        case 's': {
+            // Comando 's': são transmitidas as estatísticas do
+            // escalonador: a maior latência de cada evento (em ciclos) e os
+            // ciclos dormindo e ocupados desde a última consulta. Em seguida,
+            // são transmitidas a quantidade de amostras e o tempo em cada modo
+            // de sono no mesmo período, para o cálculo da energia por amostra
+            struct scheduler_stats stats;
+            scheduler_read_stats(&stats);
+            USART_transmit_report(USART_CHANNEL_CONTROL, "latency_command", stats.max_latency[EVENT_COMMAND]);
+            USART_transmit_report(USART_CHANNEL_CONTROL, "latency_sample", stats.max_latency[EVENT_SAMPLE]);
+            USART_transmit_report(USART_CHANNEL_CONTROL, "latency_twi", stats.max_latency[EVENT_TWI]);
+            USART_transmit_report(USART_CHANNEL_CONTROL, "latency_block", stats.max_latency[EVENT_BLOCK]);
+            USART_transmit_report(USART_CHANNEL_CONTROL, "latency_histogram", stats.max_latency[EVENT_HISTOGRAM]);
+            USART_transmit_report(USART_CHANNEL_CONTROL, "idle", stats.idle_cycles);
+            USART_transmit_report(USART_CHANNEL_CONTROL, "busy", stats.busy_cycles);
+
+            struct power_stats power;
+            power_read_stats(&power);
+            USART_transmit_report(USART_CHANNEL_CONTROL, "samples", samples_number);
+            samples_number = 0;
+            uint16_t dropped;
+            ATOMIC_BLOCK(ATOMIC_FORCEON) {
+                dropped = samples_dropped;
+                samples_dropped = 0;
+            }
+            USART_transmit_report(USART_CHANNEL_CONTROL, "samples_dropped", dropped);
+            ATOMIC_BLOCK(ATOMIC_FORCEON) {
+                dropped = spectrum_dropped;
+                spectrum_dropped = 0;
+            }
+            USART_transmit_report(USART_CHANNEL_CONTROL, "blocks_dropped", dropped);
+            USART_transmit_report(USART_CHANNEL_CONTROL, "log_dropped", eeprom_log_dropped);
+#ifdef MULTIDROP
+            USART_transmit_report(USART_CHANNEL_CONTROL, "usart_dropped", usart_dropped);
+#endif
+            USART_transmit_report(USART_CHANNEL_CONTROL, "sleep_idle", power.entries[POWER_MODE_IDLE]);
+            USART_transmit_report(USART_CHANNEL_CONTROL, "sleep_idle_cycles", power.idle_cycles);
+            USART_transmit_report(USART_CHANNEL_CONTROL, "sleep_down", power.entries[POWER_MODE_DOWN]);
+            USART_transmit_report(USART_CHANNEL_CONTROL, "sleep_down_ms", power.down_milliseconds);
+
+            // Tempos de boot (em ciclos)
+            USART_transmit_report(USART_CHANNEL_CONTROL, "boot_ready", boot_ready_cycles);
+            USART_transmit_report(USART_CHANNEL_CONTROL, "boot_first_queued", boot_first_queued_cycles);
+
+            // Maior atraso da amostra até a saída do controle (em ciclos, ver
+            // o início do arquivo), arredondado para cima pelo prescaler
+            uint8_t latency;
+            ATOMIC_BLOCK(ATOMIC_FORCEON) {
+                latency = control_max_latency;
+                control_max_latency = 0;
+            }
+            USART_transmit_report(USART_CHANNEL_CONTROL, "control_latency",
+                (uint32_t) (latency + 1) * timer0_prescalers[sampling_clock_select - 1]);
+
+#ifdef DEBUG_UART
+            // Registros do log descartados, e frames abortados, na serial de
+            // depuração
+            struct debug_stats debug;
+            debug_read_stats(&debug);
+            USART_transmit_report(USART_CHANNEL_CONTROL, "debug_records_dropped", debug.records_dropped);
+            USART_transmit_report(USART_CHANNEL_CONTROL, "debug_late", debug.late);
+#endif
+            break;
+        }
+
+        case 'c':
+            // Comando 'c<0|1>': desliga/liga o controle PID
+            if (command_argument) {
+                config.flags |= CONFIG_CONTROL;
+            } else {
+                config.flags &= ~CONFIG_CONTROL;
+            }
+            control_update();
+            sampling_update();
+            break;
+
+        case 'e':
+            // Comando 'e<valor>': setpoint do controle, na escala do ADC
+            if (command_argument <= 1023) {
+                config.setpoint = command_argument;
+                control_apply_config();
+            }
+            break;
+
+        case 'm':
+            // Comando 'm<0|1>': desliga/liga o medidor de energia
+            if (command_argument) {
+                config.flags |= CONFIG_METER;
+            } else {
+                config.flags &= ~CONFIG_METER;
+            }
+            meter_update();
+            sampling_update();
+            break;
+
+        case 'f':
+            // Comando 'f<0|1>': desliga/liga o modo de espectro
+            if (command_argument) {
+                config.flags |= CONFIG_SPECTRUM;
+            } else {
+                config.flags &= ~CONFIG_SPECTRUM;
+            }
+            spectrum_update();
+            sampling_update();
+            break;
+
+        case 'u': {
+            // Comando 'u<canal><tabela>': tabela de linearização do canal (ver
+            // `linearize.h`). "u1" é a tabela 1 no canal 0, e "u12" a tabela 2
+            // no canal 1
+            uint8_t channel = command_argument / 10;
+            uint8_t table = command_argument % 10;
+            if (channel < CHANNELS_NUMBER && table < LINEARIZE_TABLES_NUMBER) {
+                config.linearize[channel] = table;
+            }
+            break;
+        }
+
+        case 'z':
+            // Comando 'z<0|1>': desliga/liga o modo de eventos
+            if (command_argument) {
+                config.flags |= CONFIG_EVENTS;
+                events_reset();
+            } else {
+                config.flags &= ~CONFIG_EVENTS;
+            }
+            break;
+
+        case 'o':
+            // Comando 'o<valor>': nível médio da detecção de eventos (em LSB)
+            if (command_argument <= 1023) {
+                config.events_middle = command_argument;
+                events_reset();
+            }
+            break;
+
+        case 'y':
+            // Comando 'y<valor>': histerese da detecção de eventos (em LSB)
+            if (command_argument <= 511) {
+                config.events_hysteresis = command_argument;
+                events_reset();
+            }
+            break;
+
+        case 'b':
+            // Comando 'b<0|1>': desliga/liga o modo de histograma
+            histogram_enable(command_argument);
+            sampling_update();
+            break;
+
+        case 'j':
+            // Comando 'j<largura>': largura das faixas do histograma (em LSB,
+            // potência de 2 de 16 a 1024). Os contadores são zerados
+            for (uint8_t shift = HISTOGRAM_SHIFT_MIN; shift <= 10; ++shift) {
+                if (command_argument == 1u << shift) {
+                    config.histogram_shift = shift;
+                    histogram_enable(histogram_running);
+                }
+            }
+            break;
+
+        case 'g':
+            // Comando 'g<segundos>': período da transmissão do histograma (0
+            // só transmite pelo comando 'q')
+            config.histogram_period = command_argument;
+            histogram_set_period();
+            break;
+
+        case 'q':
+            // Comando 'q' ou 'q1': transmite o histograma, e com 'q1' zera os
+            // contadores
+            if (histogram_dump(command_argument)) {
+                stream_header_tick();
+            }
+            break;
+
+        case 'B':
+            // Comando 'B': reseta no bootloader, para a atualização do
+            // programa pela serial (ver `boot.h`). A escrita do log é
+            // concluída antes
+            while (eeprom_log_busy()) { }
+            USART_flush();
+            boot_request();
+            break;
+
+        case 'A':
+            // Comando 'A<endereço>': endereço da placa no barramento
+            // multiponto (ver `usart.h`), de 1 a 255. Vale a partir do
+            // próximo frame de endereço
+            if (command_argument != USART_BUS_BROADCAST && command_argument <= 0xFF) {
+                config.bus_address = command_argument;
+            }
+            break;
+
+        case 'I':
+            // Comando 'I<id>': identificação da calibração da placa,
+            // informada no cabeçalho do stream
+            config.calibration_id = command_argument;
+            break;
+
+        case 'h': {
+            // Comando 'h<canal><janela>': janela do filtro de mediana do canal
+            // (ímpar, até `MEDIAN_WINDOW_MAX`, e 1 desliga o filtro). "h5" é
+            // a janela de 5 no canal 0, e "h13" a de 3 no canal 1
+            uint8_t channel = command_argument / 10;
+            uint8_t size = command_argument % 10;
+            if (channel < CHANNELS_NUMBER && median_reset(&medians[channel], size)) {
+                config.median[channel] = size;
+            }
+            break;
+        }
+
+        case 'p':
+        case 'i':
+        case 'k':
+            // Comandos 'p<ganho>', 'i<ganho>' e 'k<ganho>': ganhos
+            // proporcional, integral e derivativo do controle, em Q8.8 (256
+            // corresponde a 1,0)
+            if (command_argument <= INT16_MAX) {
+                int16_t gain = command_argument;
+                if (command == 'p') {
+                    config.kp = gain;
+                } else if (command == 'i') {
+                    config.ki = gain;
+                } else {
+                    config.kd = gain;
+                }
+                control_apply_config();
+            }
+            break;
+
+        case 't':
+            // Comando 't<0|1>': desabilita/habilita a telemetria do controle
+            if (command_argument) {
+                config.flags |= CONFIG_TELEMETRY;
+            } else {
+                config.flags &= ~CONFIG_TELEMETRY;
+            }
+            break;
+
+        case 'r':
+            // Comando 'r<taxa>': altera a taxa de amostragem (em Hz)
+            sampling_change_rate(command_argument, sample_ring_count(&samples));
+            break;
+
+        case 'v':
+            // Comando 'v<0|1>': desabilita/habilita o modo adaptativo
+            if (command_argument) {
+                config.flags |= CONFIG_ADAPTIVE;
+                pipeline_activity_reset();
+            } else {
+                config.flags &= ~CONFIG_ADAPTIVE;
+            }
+            break;
+
+        case 'n':
+            // Comando 'n<taxa>': taxa mínima do modo adaptativo (em Hz)
+            if (command_argument >= SAMPLING_RATE_MIN && command_argument <= config.adaptive_max) {
+                config.adaptive_min = command_argument;
+            }
+            break;
+
+        case 'x':
+            // Comando 'x<taxa>': taxa máxima do modo adaptativo (em Hz)
+            if (command_argument <= SAMPLING_RATE_MAX && command_argument >= config.adaptive_min) {
+                config.adaptive_max = command_argument;
+            }
+            break;
+
+        case 'a':
+            // Comando 'a<0|1>': desabilita/habilita o auto-start
+            if (command_argument) {
+                config.flags |= CONFIG_AUTO_START;
+            } else {
+                config.flags &= ~CONFIG_AUTO_START;
+            }
+            break;
+
+        case 'l':
+            // Comando 'l<0|1>': desabilita/habilita o log na EEPROM
+            if (command_argument) {
+                config.flags |= CONFIG_LOGGING;
+            } else {
+                config.flags &= ~CONFIG_LOGGING;
+            }
+            sampling_update();
+            break;
+
+        case 'd':
+            // Comando 'd': transmite o log da EEPROM
+            dump_log();
+            break;
+
+        case 'w':
+            // Comando 'w': grava a configuração atual na EEPROM, para ser
+            // restaurada no próximo boot. A escrita do log é concluída antes,
+            // pois a EEPROM só faz uma escrita por vez
+            while (eeprom_log_busy()) { }
+            config_save();
             break;
 
         default:
-            // Ao receber qualquer outro valor, nada é feito
+            // Comandos desconhecidos são ignorados
             break;
     }
+
+    // A configuração alterada fica visível para o mestre do TWI, e no stream
+    twi_publish_config(twi_sampling ? TWI_CONTROL_SAMPLING : 0);
+    stream_header_update(false);
 }
 
+// Trata os bytes recebidos pela serial.
+//
+// Os bytes '0' e '1' param e iniciam a transmissão imediatamente. Os demais
+// comandos são formados por uma letra, seguida opcionalmente de um argumento
+// decimal, e são executados ao receber '\r' ou '\n' (por exemplo, "r250\n").
+void handle_command(void) {
+    uint8_t data;
+    while (USART_receive(&data)) {
+        if (command != '\0') {
+            if (data >= '0' && data <= '9') {
+                uint8_t digit = data - '0';
+                if (command_argument > (UINT16_MAX - digit) / 10) {
+                    command_overflow = true;
+                } else {
+                    command_argument = command_argument*10 + digit;
+                }
+            } else if (data == '\r' || data == '\n') {
+                // Um argumento grande demais não é reduzido a um valor
+                // válido: o comando é descartado
+                if (!command_overflow) {
+                    execute_command();
+                }
+                command = '\0';
+            } else {
+                // Comando malformado, descartado
+                command = '\0';
+            }
+            continue;
+        }
 
-// Caracteres dos dígitos
-uint8_t digits[10] = {
-    '0', '1', '2', '3', '4', '5', '6', '7', '8', '9',
-};
+        switch (data) {
+            case '0':
+                // Ao receber '0' pela serial, transmissão é parada
+                should_transmit = false;
+                sampling_update();
+                break;
+
+            case '1':
+                // Ao receber '1' pela serial, transmissão é realizada, a
+                // partir do cabeçalho do stream
+                if (!boot_has_transmitted) {
+                    boot_transmit_start = timebase_now32();
+                }
+                should_transmit = true;
+                sampling_update();
+                stream_header_update(true);
+                break;
+
+            default:
+                // Uma letra (minúscula ou maiúscula) inicia um comando com
+                // argumento, e qualquer outro valor é ignorado
+                if ((data >= 'a' && data <= 'z') || (data >= 'A' && data <= 'Z')) {
+                    command = data;
+                    command_argument = 0;
+                    command_overflow = false;
+                }
+                break;
+        }
+    }
+}
+
+// Transmite uma amostra, ou a salva no log da EEPROM
+void output_sample(struct sample sample) {
+    if (!should_transmit) {
+        if (config.flags & CONFIG_LOGGING) {
+            eeprom_log_add(sample.value);
+        }
+        return;
+    }
+
+    // Formata a amostra, linearizada caso o canal tenha uma tabela, ou a
+    // linha de telemetria (ver `pipeline.h`)
+    uint8_t chars[PIPELINE_TELEMETRY_MAX];
+    uint8_t length;
+    if (config.flags & CONFIG_TELEMETRY) {
+        length = pipeline_telemetry(config.setpoint, sample.value, sample.output, chars);
+    } else if (config.linearize[sample.channel] != LINEARIZE_NONE) {
+        length = pipeline_units(linearize(config.linearize[sample.channel], sample.value), chars);
+    } else {
+        length = pipeline_process(sample.value, chars);
+    }
+
+    // Transmite a linha inteira, ou a descarta caso não haja espaço na fila
+    // de transmissão (a taxa de amostragem é maior do que a serial suporta)
+    if (!USART_try_transmit(USART_CHANNEL_DATA, chars, length)) {
+        ATOMIC_BLOCK(ATOMIC_FORCEON) {
+            samples_dropped += 1;
+        }
+        return;
+    }
+
+    stream_header_tick();
+
+    if (!boot_has_transmitted) {
+        boot_has_transmitted = true;
+        boot_first_queued_cycles = timebase_now32() - boot_transmit_start;
+    }
+}
+
+// Passa uma amostra para o medidor de energia, transmitindo o registro ao fim
+// de cada segundo
+void meter_sample(struct sample sample) {
+    struct meter_record record;
+    if (!meter_add(sample.channel, sample.value, &record) || !should_transmit) {
+        return;
+    }
 
-// Função para envio por pooling de um byte pela serial
-void USART_transmit(uint8_t data) {
-    // Espera que o buffer de transmissão fique vazio
-    while ((UCSR0A & (1<<5)) == 0) { }
-    // Insere o byte no buffer de transmissão
-    UDR0 = data;
+    uint8_t chars[METER_RECORD_MAX];
+    uint8_t length = meter_format(&record, chars);
+    for (uint8_t i = 0; i < length; ++i) {
+        USART_transmit(USART_CHANNEL_DATA, chars[i]);
+    }
+    stream_header_tick();
 }
 
+// Trata as amostras lidas pelo ADC
+void handle_sample(void) {
+    // As amostras são retiradas da fila em blocos
+    struct sample block[4];
+    uint8_t n;
+    while ((n = sample_ring_pop_bulk(&samples, block, 4)) != 0) {
+        samples_number += n;
+
+        for (uint8_t i = 0; i < n; ++i) {
+            block[i].value = median_filter(&medians[block[i].channel], block[i].value);
+            twi_add_sample(block[i].channel, block[i].value);
+
+            // As conversões cujas amostras foram descartadas também contam
+            sample_time += (uint8_t) (block[i].sequence - last_sequence);
+            last_sequence = block[i].sequence;
+
+            // Aviso da mudança de taxa, antes da primeira amostra na nova taxa
+            if (rate_report_pending) {
+                if (rate_report_countdown == 0) {
+                    rate_report_pending = false;
+                    if (should_transmit) {
+                        USART_transmit_report(USART_CHANNEL_DATA, "rate", config.sampling_rate);
+                    }
+                    stream_header.rate = config.sampling_rate;
+                    events_reset();
+                } else {
+                    rate_report_countdown -= 1;
+                }
+            }
+
+            // No medidor de energia, só o registro de cada segundo é
+            // transmitido. As amostras de ADC1 que restarem na fila depois
+            // de o medidor ser desligado são descartadas
+            if (meter_running) {
+                meter_sample(block[i]);
+                continue;
+            }
+            if (block[i].channel != 0) {
+                continue;
+            }
+            if (config.flags & CONFIG_EVENTS) {
+                events_sample(block[i]);
+                continue;
+            }
+            output_sample(block[i]);
+
+            // As amostras seguintes do bloco e as que estão na fila já foram
+            // tomadas na taxa atual
+            sampling_adapt(block[i].value, n - 1 - i + sample_ring_count(&samples));
+        }
+    }
+}
+
+// Transmite o histograma do fim de um período, zerando os contadores
+void handle_histogram(void) {
+    if (histogram_dump(true)) {
+        stream_header_tick();
+    }
+}
+
+// Transmite o espectro do bloco completo, com as magnitudes separadas por
+// vírgulas em uma linha, e libera o bloco para a interrupção do ADC
+void handle_block(void) {
+    uint16_t *block = buffers.spectrum[spectrum_fill ^ 1];
+    if (spectrum_running && should_transmit) {
+        fft_magnitudes(block);
+        for (uint8_t i = 0; i < FFT_BINS; ++i) {
+            if (i != 0) {
+                USART_transmit(USART_CHANNEL_DATA, ',');
+            }
+            USART_transmit_decimal(USART_CHANNEL_DATA, block[i]);
+        }
+        USART_transmit(USART_CHANNEL_DATA, '\r');
+        USART_transmit(USART_CHANNEL_DATA, '\n');
+        stream_header_tick();
+    }
+    spectrum_busy = false;
+}
+
+// Aplica a configuração escrita pelo mestre do TWI
+void handle_twi(void) {
+    struct twi_config twi_config;
+    twi_read_config(&twi_config);
+
+    // Uma taxa inválida é ignorada
+    sampling_change_rate(twi_config.sampling_rate, sample_ring_count(&samples));
+    // Todos os bits das flags estão em uso. O modo de eventos, ao ser ligado,
+    // recomeça a contagem do tempo
+    if (twi_config.flags & ~config.flags & CONFIG_EVENTS) {
+        events_reset();
+    }
+    config.flags = twi_config.flags;
+    twi_sampling = twi_config.control & TWI_CONTROL_SAMPLING;
+    control_update();
+    meter_update();
+    spectrum_update();
+    sampling_update();
+
+    if (twi_config.control & TWI_CONTROL_SAVE) {
+        while (eeprom_log_busy()) { }
+        config_save();
+    }
+
+    // Os registradores passam a mostrar a configuração efetivamente aplicada,
+    // e o stream, o seu novo cabeçalho
+    twi_publish_config(twi_sampling ? TWI_CONTROL_SAMPLING : 0);
+    stream_header_update(false);
+}
+
+// Tratadores de cada tipo de evento
+const event_handler_t handlers[EVENTS_NUMBER] = {
+    [EVENT_COMMAND] = handle_command,
+    [EVENT_SAMPLE] = handle_sample,
+    [EVENT_TWI] = handle_twi,
+    [EVENT_BLOCK] = handle_block,
+    [EVENT_HISTOGRAM] = handle_histogram,
+};
+
 
 int main() {
-    // Configura todos os pinos expostos do ATmega328p como entrada pull-up
-    DDRB = 0b00000000;
+    // Restaura a configuração salva na EEPROM
+    config_load();
+
+    // Configura todos os pinos expostos do ATmega328p como entrada pull-up,
+    // exceto as entradas analógicas ADC0 e ADC1, que ficam sem pull-up para não carregar
+    // o sinal medido, e a saída do controle OC2A (PB3), que fica em 0 enquanto
+    // o PWM está desligado
+    DDRB = 0b00001000;
     DDRC = 0b00000000;
     DDRD = 0b00000000;
-    PORTB = 0b11111111;
-    PORTC = 0b01111111;
+    PORTB = 0b11110111;
+    PORTC = 0b01111100;
     PORTD = 0b11111111;
 
+#ifdef DEBUG_UART
+    // Serial de depuração no pino OC1B (PB2, ver `debug.h`)
+    debug_init();
+#endif
+
+    // Desliga os módulos não utilizados e os buffers digitais das entradas
+    // ADC0 e ADC1
+    power_init(0b00000011);
+
 
     // Configuração do Timer 0, utilizado para a amostragem da entrada analógica
 
     // Modo de operação CTC (Clear Timer on Compare Match)
-    // Prescaler de 64
-    TCCR0A = 0b00000010;
-    TCCR0B = 0b00000011;
+    // Timer parado até o início da amostragem, quando é configurado o
+    // prescaler escolhido em `sampling_set_rate` (ver `sampling_start`)
+    TCCR0A = REG_CONFIG(TCCR0A, REG_FIELD(TCCR0A_WGM, TIMER0_WGM_CTC));
+    TCCR0B = REG_CONFIG(TCCR0B, REG_FIELD(TCCR0B_CS, TIMER_CLOCK_STOPPED));
 
-    // Habilita a interrupção quando o timer atinge TOP
-    TIMSK0 = 0b00000010;
+    // Nenhuma interrupção do timer é habilitada (a flag de compare match é
+    // limpa pela interrupção do ADC)
+    TIMSK0 = REG_CONFIG(TIMSK0, REG_FIELD(TIMSK0_OCIE0A, 0));
 
     // Timer começa em 0
     TCNT0 = 0;
 
-    // TOP do timer (64 se refere ao prescaler configurado anteriormente)
-    OCR0A = CPU_CLOCK / 64 / SAMPLING_RATE - 1;
+    // TOP do timer e prescaler para a taxa de amostragem configurada (caso a
+    // taxa salva seja inválida, é utilizada a taxa padrão)
+    if (!sampling_set_rate(config.sampling_rate)) {
+        sampling_set_rate(SAMPLING_RATE);
+    }
 
 
     // Configuração do ADC
 
     // Tensão de referência AREF externa
     // Resultado right-adjusted no registrador ADC
-    // Leitura realizada na entrada ADC0
-    ADMUX = 0b00000000;
+    // Leitura realizada na entrada ADC0 (ver `ADMUX_CONFIG`)
+    ADMUX = ADMUX_CONFIG(0);
 
-    // Habilita o ADC
+    // ADC desabilitado até o início da amostragem (ver `sampling_start`)
     // Habilita a interrupção quando o ADC termina a conversão
     // Prescaler de 16
     // Habilita o auto trigger da conversão do ADC em Timer/Counter0 Compare Match A
-    ADCSRA = 0b10101100;
-    ADCSRB = 0b00000011;
+    ADCSRA = ADCSRA_CONFIG(0, 0);
+    ADCSRB = REG_CONFIG(ADCSRB, REG_FIELD(ADCSRB_ADTS, ADC_TRIGGER_TIMER0_COMPA));
 
 
-    // Configuração do protocolo USART
+    // Detecção de eventos com o nível e a histerese configurados
+    events_reset();
+
+    // Filtros de mediana com as janelas configuradas (uma janela inválida
+    // desliga o filtro)
+    for (uint8_t i = 0; i < CHANNELS_NUMBER; ++i) {
+        if (!median_reset(&medians[i], config.median[i])) {
+            median_reset(&medians[i], 1);
+            config.median[i] = 1;
+        }
+    }
 
-    // Modo assíncrono, velocidade de transmissão dobrada
-    // 8 bits de dados por frame, sem bit de paridade, 1 bit de parada
-    // Habilita as funções de transmissor e receptor
-    // Habilita interrupção ao concluir uma recepção
-    UCSR0A = 0b00000010;
-    UCSR0B = 0b10011000;
-    UCSR0C = 0b00000110;
 
-    // Configura o baud rate (8 se refere ao prescaler quando em
-    // modo assíncrono com velocidade de transmissão dobrada)
-    UBRR0 = CPU_CLOCK / 8 / BAUD_RATE - 1;
+    // Configuração do protocolo USART (ver `usart.h`)
+    USART_init();
 
+    // Interface TWI escrava, com um registrador de amostra por canal (ver `twi.h`)
+    twi_init(CHANNELS_NUMBER);
+    twi_publish_config(0);
 
-    // Habilita todas as interrupções
+#ifdef BENCHMARK
+    // Mede o custo das filas antes de iniciar o programa (ver `benchmark.h`)
     sei();
+    benchmark_run();
+#endif
 
 
-    // Loop principal
-    while (true) {
-        if (!should_transmit) {
-            continue;
-        }
+    // Com o auto-start, a amostragem começa sem esperar o comando '1'. Sem
+    // ele, a amostragem também começa caso o log, o controle ou o medidor de
+    // energia estejam habilitados
+    if (config.flags & CONFIG_AUTO_START) {
+        should_transmit = true;
+    }
+    control_update();
+    meter_update();
+    spectrum_update();
+    sampling_update();
 
-        if (has_new_sample) {
-            has_new_sample = false;
+    boot_ready_cycles = timebase_now();
 
-            uint16_t current_sample = sample;
 
-            // Calcula os dígitos da representação decimal do valor
-            uint8_t chars[4];
-            for (uint8_t i = 0; i < 4; ++i) {
-                chars[3-i] = digits[current_sample%10];
-                current_sample /= 10;
-            }
+    // Habilita todas as interrupções
+    sei();
 
-            // Transmite os dígitos pela serial, com uma quebra de linha entre cada um
-            for (uint8_t i = 0; i < 4; ++i) {
-                USART_transmit(chars[i]);
-            }
-            USART_transmit('\r');
-            USART_transmit('\n');
-        }
-    }
+    // Com o auto-start, o stream começa pelo cabeçalho
+    stream_header_update(true);
+
+    LOG1(BOOT_READY, boot_ready_cycles);
+
+
+    // Trata os eventos postados pelas interrupções
+    scheduler_run(handlers);
 }
@@ -0,0 +1,55 @@
+#include "median.h"
+
+
+uint8_t median_reset(struct median *median, uint8_t size) {
+    if (size % 2 == 0 || size > MEDIAN_WINDOW_MAX) {
+        return 0;
+    }
+    median->size = size;
+    median->count = 0;
+    median->oldest = 0;
+    return size;
+}
+
+uint16_t median_filter(struct median *median, uint16_t sample) {
+    if (median->size <= 1) {
+        return sample;
+    }
+
+    uint16_t *sorted = median->sorted;
+    uint8_t count = median->count;
+
+    // Posição livre na janela ordenada: no fim enquanto ela não está cheia,
+    // ou a posição da amostra mais antiga, que é substituída no histórico
+    uint8_t position;
+    if (count < median->size) {
+        median->history[count] = sample;
+        position = count;
+        count += 1;
+        median->count = count;
+    } else {
+        uint8_t oldest = median->oldest;
+        uint16_t removed = median->history[oldest];
+        median->history[oldest] = sample;
+        median->oldest = oldest + 1 == count ? 0 : oldest + 1;
+
+        position = 0;
+        while (sorted[position] != removed) {
+            position += 1;
+        }
+    }
+
+    // A nova amostra é colocada na posição livre e levada até a sua posição
+    // ordenada, em uma das duas direções
+    while (position > 0 && sorted[position - 1] > sample) {
+        sorted[position] = sorted[position - 1];
+        position -= 1;
+    }
+    while (position + 1 < count && sorted[position + 1] < sample) {
+        sorted[position] = sorted[position + 1];
+        position += 1;
+    }
+    sorted[position] = sample;
+
+    return sorted[count / 2];
+}
@@ -0,0 +1,185 @@
+#include "meter.h"
+
+
+// Taxa de amostragem e quantidade de pares por janela
+static uint16_t window_rate;
+static uint16_t window_pairs;
+
+// Correção do ganho da interpolação para a taxa atual, com 16 bits
+// fracionários
+static uint32_t window_gain;
+
+// Somas da janela atual. A tensão de cada par é a soma das duas amostras
+// vizinhas (o dobro da interpolada), para não perder o bit da média. A tensão
+// eficaz é calculada com as amostras originais, sem interpolação
+static uint16_t pairs;
+static uint16_t voltages;
+static uint32_t sum_voltage;
+static uint64_t sum_voltage_squared;
+static uint32_t sum_pair_voltage;
+static uint32_t sum_current;
+static uint64_t sum_current_squared;
+static uint64_t sum_product;
+
+// Última tensão e corrente ainda sem par
+static bool has_voltage;
+static bool has_current;
+static uint16_t last_voltage;
+static uint16_t last_current;
+
+// Energia acumulada (µJ)
+static int64_t energy;
+
+
+// Raiz quadrada inteira (arredondada para baixo)
+static uint32_t isqrt(uint64_t value) {
+    uint64_t root = 0;
+    uint64_t bit = (uint64_t) 1 << 62;
+    while (bit > value) {
+        bit >>= 2;
+    }
+    while (bit != 0) {
+        if (value >= root + bit) {
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return root;
+}
+
+// Zera as somas da janela
+static void clear_window(void) {
+    pairs = 0;
+    voltages = 0;
+    sum_voltage = 0;
+    sum_voltage_squared = 0;
+    sum_pair_voltage = 0;
+    sum_current = 0;
+    sum_current_squared = 0;
+    sum_product = 0;
+}
+
+void meter_set_rate(uint16_t rate) {
+    // Cada par ocupa duas amostras
+    window_rate = rate;
+    window_pairs = rate / 2;
+    window_gain = 65536;
+    if (rate >= METER_RATE_MIN) {
+        window_gain += METER_GAIN_CORRECTION / ((uint32_t) rate * rate);
+    }
+    clear_window();
+
+    // As amostras anteriores foram tomadas em outra taxa
+    has_voltage = false;
+    has_current = false;
+}
+
+void meter_reset(uint16_t rate) {
+    energy = 0;
+    meter_set_rate(rate);
+}
+
+// Calcula o resultado da janela a partir das somas
+static void finish_window(struct meter_record *record) {
+    uint64_t n = pairs;
+    uint64_t n2 = n * n;
+    uint64_t m = voltages;
+
+    // Variâncias em LSB², com 16 bits fracionários, e valores eficazes com 8
+    uint64_t voltage_variance =
+        ((m * sum_voltage_squared - (uint64_t) sum_voltage * sum_voltage) << 16) / (m * m);
+    uint64_t current_variance =
+        ((n * sum_current_squared - (uint64_t) sum_current * sum_current) << 16) / n2;
+    uint32_t voltage_rms = isqrt(voltage_variance);
+    uint32_t current_rms = isqrt(current_variance);
+    record->voltage_rms = ((uint64_t) voltage_rms * METER_VOLTAGE_SCALE) >> 16;
+    record->current_rms = ((uint64_t) current_rms * METER_CURRENT_SCALE) >> 16;
+
+    // Potência em LSB², com 8 bits fracionários (a tensão dos pares está
+    // dobrada), e depois em µW (mV * mA), com a correção da interpolação
+    int64_t covariance =
+        (int64_t) (n * sum_product) - (int64_t) ((uint64_t) sum_pair_voltage * sum_current);
+    int64_t power = covariance * 256 / (int64_t) (2 * n2);
+    int64_t power_uw = (power * (int64_t) METER_VOLTAGE_SCALE * (int64_t) METER_CURRENT_SCALE) >> 24;
+    power_uw = (power_uw * window_gain) >> 16;
+    record->power = power_uw / 1000;
+
+    // A janela dura 2 * pares amostras
+    energy += power_uw * (int64_t) (2 * pairs) / window_rate;
+    record->energy = energy / 3600000;
+}
+
+bool meter_add(uint8_t input, uint16_t sample, struct meter_record *record) {
+    if (input == METER_CURRENT) {
+        last_current = sample;
+        has_current = true;
+        return false;
+    }
+
+    // Uma corrente entre duas tensões forma um par. Caso alguma amostra tenha
+    // sido perdida, o par incompleto é descartado
+    voltages += 1;
+    sum_voltage += sample;
+    sum_voltage_squared += (uint32_t) sample * sample;
+
+    bool complete = false;
+    if (has_voltage && has_current) {
+        uint16_t voltage = last_voltage + sample;
+        sum_pair_voltage += voltage;
+        sum_current += last_current;
+        sum_current_squared += (uint32_t) last_current * last_current;
+        sum_product += (uint32_t) voltage * last_current;
+        pairs += 1;
+
+        if (pairs >= window_pairs) {
+            finish_window(record);
+            clear_window();
+            complete = true;
+        }
+    }
+
+    has_current = false;
+    has_voltage = true;
+    last_voltage = sample;
+    return complete;
+}
+
+
+// Escreve `value` em decimal, com o sinal caso seja negativo. Retorna a
+// quantidade de bytes escritos
+static uint8_t format_decimal(int32_t value, uint8_t *out) {
+    uint8_t length = 0;
+    uint32_t magnitude = value;
+    if (value < 0) {
+        out[length++] = '-';
+        magnitude = -magnitude;
+    }
+
+    uint8_t digits[10];
+    uint8_t n = 0;
+    do {
+        digits[n++] = '0' + magnitude%10;
+        magnitude /= 10;
+    } while (magnitude != 0);
+    while (n > 0) {
+        out[length++] = digits[--n];
+    }
+    return length;
+}
+
+uint8_t meter_format(const struct meter_record *record, uint8_t out[METER_RECORD_MAX]) {
+    uint8_t length = 0;
+    length += format_decimal(record->voltage_rms, out + length);
+    out[length++] = ',';
+    length += format_decimal(record->current_rms, out + length);
+    out[length++] = ',';
+    length += format_decimal(record->power, out + length);
+    out[length++] = ',';
+    length += format_decimal(record->energy, out + length);
+    out[length++] = '\r';
+    out[length++] = '\n';
+    return length;
+}
@@ -0,0 +1,36 @@
+#include "pid.h"
+
+
+// Limites do termo integral e da soma dos termos (saída em Q8.8)
+#define OUTPUT_MIN_Q8 ((int32_t) PID_OUTPUT_MIN << 8)
+#define OUTPUT_MAX_Q8 ((int32_t) PID_OUTPUT_MAX << 8)
+
+
+void pid_reset(struct pid *pid, uint16_t measurement, uint8_t output) {
+    pid->integral = (int32_t) output << 8;
+    pid->last_measurement = measurement;
+}
+
+uint8_t pid_update(struct pid *pid, uint16_t measurement) {
+    int16_t error = (int16_t) (pid->setpoint - measurement);
+    int16_t change = (int16_t) (measurement - pid->last_measurement);
+    pid->last_measurement = measurement;
+
+    // Anti-windup: o termo integral fica dentro da faixa da saída
+    int32_t integral = pid->integral + (int32_t) pid->ki * error;
+    if (integral > OUTPUT_MAX_Q8) {
+        integral = OUTPUT_MAX_Q8;
+    } else if (integral < OUTPUT_MIN_Q8) {
+        integral = OUTPUT_MIN_Q8;
+    }
+    pid->integral = integral;
+
+    int32_t output = (int32_t) pid->kp * error + integral - (int32_t) pid->kd * change;
+    if (output > OUTPUT_MAX_Q8) {
+        return PID_OUTPUT_MAX;
+    }
+    if (output < OUTPUT_MIN_Q8) {
+        return PID_OUTPUT_MIN;
+    }
+    return output >> 8;
+}
@@ -0,0 +1,87 @@
+#include "pipeline.h"
+
+
+uint8_t pipeline_process(uint16_t sample, uint8_t out[PIPELINE_OUTPUT_MAX]) {
+    // Calcula os dígitos da representação decimal do valor, seguidos de uma
+    // quebra de linha
+    for (uint8_t j = 0; j < 4; ++j) {
+        out[3-j] = '0' + sample%10;
+        sample /= 10;
+    }
+    out[4] = '\r';
+    out[5] = '\n';
+    return 6;
+}
+
+// Escreve os `digits` dígitos decimais de `value` em `out`
+static void format_decimal(uint16_t value, uint8_t *out, uint8_t digits) {
+    for (uint8_t j = digits; j > 0; --j) {
+        out[j-1] = '0' + value%10;
+        value /= 10;
+    }
+}
+
+uint8_t pipeline_units(int16_t value, uint8_t out[PIPELINE_UNITS_MAX]) {
+    // O módulo de -32768 é calculado em 16 bits sem sinal
+    uint16_t magnitude = value < 0 ? -(uint16_t) value : (uint16_t) value;
+    out[0] = value < 0 ? '-' : '+';
+    format_decimal(magnitude, out + 1, 5);
+    out[6] = '\r';
+    out[7] = '\n';
+    return 8;
+}
+
+uint8_t pipeline_telemetry(
+    uint16_t setpoint, uint16_t measurement, uint8_t output,
+    uint8_t out[PIPELINE_TELEMETRY_MAX]
+) {
+    format_decimal(setpoint, out, 4);
+    out[4] = ',';
+    format_decimal(measurement, out + 5, 4);
+    out[9] = ',';
+    format_decimal(output, out + 10, 3);
+    out[13] = '\r';
+    out[14] = '\n';
+    return 15;
+}
+
+
+// Janela atual da estimativa de atividade: amostras, soma das variações
+// absolutas e a última amostra
+static uint8_t activity_count = 0;
+static uint16_t activity_sum;
+static uint16_t activity_last;
+
+int8_t pipeline_activity(uint16_t sample, uint8_t high, uint8_t low) {
+    if (activity_count == 0) {
+        // Primeira amostra da janela: só serve de referência
+        activity_last = sample;
+        activity_sum = 0;
+        activity_count = 1;
+        return 0;
+    }
+
+    // A soma cabe em 16 bits: no máximo 32 variações de 1023
+    activity_sum += sample > activity_last ? sample - activity_last : activity_last - sample;
+    activity_last = sample;
+    activity_count += 1;
+    if (activity_count <= PIPELINE_ACTIVITY_WINDOW) {
+        return 0;
+    }
+
+    // A janela recomeça na amostra atual
+    activity_count = 1;
+    uint16_t sum = activity_sum;
+    activity_sum = 0;
+    if (sum > (uint16_t) high * PIPELINE_ACTIVITY_WINDOW) {
+        return 1;
+    }
+    if (sum < (uint16_t) low * PIPELINE_ACTIVITY_WINDOW) {
+        return -1;
+    }
+    return 0;
+}
+
+void pipeline_activity_reset(void) {
+    activity_count = 0;
+}
@@ -0,0 +1,130 @@
+#include "power.h"
+
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#include <avr/power.h>
+#include <avr/sleep.h>
+#include <stdbool.h>
+#include <util/atomic.h>
+
+#include "interrupts.h"
+#include "timebase.h"
+
+
+// Período do watchdog durante o sono: 16K ciclos do oscilador de 128 kHz
+#define WATCHDOG_PERIOD_MS 128
+#define WATCHDOG_PRESCALER ((1<<WDP1) | (1<<WDP0))
+
+
+struct power_stats power_stats;
+
+// Periféricos requisitados
+static volatile uint8_t required = 0;
+
+// Indica se o watchdog terminou o último período de sono
+static volatile bool watchdog_elapsed;
+
+
+// Interrupção do watchdog, disparada a cada período durante o power-down
+ISR(WDT_vect, ISR_NONCRITICAL) {
+    power_stats.down_milliseconds += WATCHDOG_PERIOD_MS;
+    watchdog_elapsed = true;
+}
+
+// Interrupção de mudança de nível no pino RXD, que só serve para acordar a CPU
+ISR(PCINT2_vect, ISR_NONCRITICAL) {
+    PCMSK2 = 0b00000000;
+    PCICR &= ~(1<<PCIE2);
+}
+
+
+void power_init(uint8_t analog_inputs) {
+    // Desliga TWI, SPI e Timer2
+    power_twi_disable();
+    power_spi_disable();
+    power_timer2_disable();
+
+    // Desliga o comparador analógico
+    ACSR = 1<<ACD;
+
+    // Desliga os buffers digitais das entradas analógicas, que consomem
+    // corrente quando a tensão fica entre os níveis lógicos
+    DIDR0 = analog_inputs;
+}
+
+void power_require(uint8_t peripherals) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        required |= peripherals;
+    }
+}
+
+void power_release(uint8_t peripherals) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        required &= ~peripherals;
+    }
+}
+
+void power_read_stats(struct power_stats *stats) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        *stats = power_stats;
+        power_stats = (struct power_stats) { 0 };
+    }
+}
+
+
+// Escolhe o modo mais profundo compatível com os periféricos requisitados
+static uint8_t select_mode(void) {
+    if (required != 0) {
+        return POWER_MODE_IDLE;
+    }
+    return POWER_MODE_DOWN;
+}
+
+void power_sleep(void) {
+    uint8_t mode = select_mode();
+    power_stats.entries[mode] += 1;
+
+    if (mode == POWER_MODE_IDLE) {
+        uint32_t start = timebase_now32();
+
+        set_sleep_mode(SLEEP_MODE_IDLE);
+        sleep_enable();
+        sei();
+        sleep_cpu();
+        sleep_disable();
+
+        power_stats.idle_cycles += timebase_now32() - start;
+        return;
+    }
+
+    // Watchdog em modo de interrupção, com período de 128 ms (sequência
+    // temporizada, feita com as interrupções desabilitadas)
+    watchdog_elapsed = false;
+    WDTCSR = (1<<WDCE) | (1<<WDE);
+    WDTCSR = (1<<WDIE) | WATCHDOG_PRESCALER;
+
+    // Em power-down a USART não funciona, então a CPU acorda pela mudança de
+    // nível no pino RXD
+    PCIFR = 1<<PCIE2;
+    PCMSK2 = 1<<PCINT16;
+    PCICR |= 1<<PCIE2;
+
+    set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+    sleep_enable();
+    // Desliga o BOD durante o sono (precisa ser feito imediatamente antes do
+    // `sleep`)
+    sleep_bod_disable();
+    sei();
+    sleep_cpu();
+    sleep_disable();
+
+    // Desliga o watchdog. Caso a CPU tenha acordado por outra fonte, o tempo
+    // desde o início do período é desconhecido, e é contado como metade dele
+    cli();
+    WDTCSR = (1<<WDCE) | (1<<WDE);
+    WDTCSR = 0b00000000;
+    if (!watchdog_elapsed) {
+        power_stats.down_milliseconds += WATCHDOG_PERIOD_MS / 2;
+    }
+    sei();
+}
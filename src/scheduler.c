@@ -0,0 +1,71 @@
+#include "scheduler.h"
+
+#include <avr/interrupt.h>
+#include <stdbool.h>
+#include <util/atomic.h>
+
+#include "power.h"
+
+
+struct scheduler_stats scheduler_stats;
+
+volatile uint32_t event_post_time[EVENTS_NUMBER];
+
+// Início do intervalo atual de ocupação
+static uint32_t busy_since;
+
+
+// Dorme até a próxima interrupção, caso não haja eventos pendentes
+static void sleep_if_idle(void) {
+    cli();
+    if (EVENTS == 0) {
+        uint32_t now = timebase_now32();
+        scheduler_stats.busy_cycles += now - busy_since;
+
+        // A instrução seguinte ao `sei` é sempre executada antes de qualquer
+        // interrupção, então não há como um evento ser postado entre a
+        // verificação acima e o início do sono
+        power_sleep();
+
+        busy_since = timebase_now32();
+        scheduler_stats.idle_cycles += busy_since - now;
+    }
+    sei();
+}
+
+void scheduler_run(const event_handler_t handlers[EVENTS_NUMBER]) {
+    busy_since = timebase_now32();
+
+    while (true) {
+        uint8_t event = 0;
+        while (event < EVENTS_NUMBER && (EVENTS & 1<<event) == 0) {
+            event += 1;
+        }
+
+        if (event == EVENTS_NUMBER) {
+            sleep_if_idle();
+            continue;
+        }
+
+        // O momento da postagem é lido antes de limpar o bit, pois enquanto o
+        // bit está setado nenhuma interrupção o altera. A latência satura em
+        // 65535 ciclos
+        uint32_t elapsed = timebase_now32() - event_post_time[event];
+        uint16_t latency = elapsed > UINT16_MAX ? UINT16_MAX : elapsed;
+        ATOMIC_BLOCK(ATOMIC_FORCEON) {
+            EVENTS &= ~(1<<event);
+        }
+
+        if (latency > scheduler_stats.max_latency[event]) {
+            scheduler_stats.max_latency[event] = latency;
+        }
+
+        handlers[event]();
+    }
+}
+
+void scheduler_read_stats(struct scheduler_stats *stats) {
+    *stats = scheduler_stats;
+    scheduler_stats.idle_cycles = 0;
+    scheduler_stats.busy_cycles = 0;
+}
@@ -0,0 +1,13 @@
+#include "timebase.h"
+
+#include <avr/interrupt.h>
+
+
+volatile uint16_t timebase_overflows = 0;
+
+
+// Interrupção de overflow do Timer1, a cada 65536 ciclos. Não aninha (ver
+// `timebase.h`)
+ISR(TIMER1_OVF_vect) {
+    timebase_overflows += 1;
+}
@@ -0,0 +1,239 @@
+#include "twi.h"
+
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#include <avr/power.h>
+#include <stddef.h>
+#include <util/atomic.h>
+
+#include "config.h"
+#include "interrupts.h"
+#include "power.h"
+#include "reg.h"
+#include "ring.h"
+#include "scheduler.h"
+
+
+// Mapa de registradores. O AVR é little-endian e não tem requisitos de
+// alinhamento, então os campos ficam exatamente nos endereços do mapa
+struct twi_registers {
+    uint8_t id;
+    uint8_t version;
+    uint8_t channels;
+    uint8_t reserved_03;
+    uint16_t sample[TWI_CHANNELS_MAX];
+    uint8_t fifo_count;
+    uint8_t fifo_data;
+    uint8_t reserved_16[2];
+    uint32_t samples;
+    uint16_t fifo_dropped;
+    uint8_t reserved_1e[2];
+    uint16_t sampling_rate;
+    uint8_t flags;
+    uint8_t control;
+};
+
+_Static_assert(offsetof(struct twi_registers, fifo_count) == TWI_REG_FIFO_COUNT
+    && offsetof(struct twi_registers, samples) == TWI_REG_SAMPLES
+    && offsetof(struct twi_registers, sampling_rate) == TWI_REG_SAMPLING_RATE
+    && sizeof(struct twi_registers) == TWI_REGISTERS_SIZE,
+    "endereços do mapa de registradores do TWI");
+
+static union {
+    struct twi_registers fields;
+    uint8_t bytes[TWI_REGISTERS_SIZE];
+} registers;
+
+// Fila de amostras lidas pelo mestre (produtor: contexto principal,
+// consumidor: interrupção do TWI)
+RING_DEFINE(twi_fifo_ring, uint16_t, 32)
+static struct twi_fifo_ring fifo;
+
+// Endereço do registrador atual, e se ele já foi recebido na escrita atual
+static uint8_t pointer;
+static bool pointer_received;
+
+// Byte alto da amostra retirada da fila, ainda não lido pelo mestre
+static uint8_t fifo_high;
+static bool fifo_high_pending = false;
+
+// Estatísticas, copiadas para o mapa quando o mestre não o está lendo
+static uint32_t samples = 0;
+static uint16_t fifo_dropped = 0;
+
+// Indica se o mestre está lendo o mapa, e se escreveu na configuração
+static volatile bool reading = false;
+static bool config_written = false;
+
+// Bytes da configuração escritos pelo mestre e ainda não lidos pelo contexto
+// principal (bit 0: `TWI_REG_SAMPLING_RATE`), que não são sobrescritos por
+// `twi_publish_config`. Só é alterado com as interrupções desabilitadas
+static uint8_t config_pending = 0;
+
+
+// Configuração do TWCR como escravo: TWI e interrupção habilitados, com
+// reconhecimento (ACK) do endereço e dos dados. `TWINT` é escrito como 1 para
+// liberar o barramento
+#define TWCR_SLAVE REG_CONFIG(TWCR,                                             \
+    REG_FIELD(TWCR_TWINT, 1),                                                   \
+    REG_FIELD(TWCR_TWEA, 1),                                                    \
+    REG_FIELD(TWCR_TWEN, 1),                                                    \
+    REG_FIELD(TWCR_TWIE, 1))
+
+
+static uint8_t read_register(void) {
+    if (pointer == TWI_REG_FIFO_DATA) {
+        if (fifo_high_pending) {
+            fifo_high_pending = false;
+            return fifo_high;
+        }
+        // Fila vazia é lida como 0xFFFF, que não é um valor válido do ADC
+        uint16_t sample = 0xFFFF;
+        twi_fifo_ring_pop(&fifo, &sample);
+        fifo_high = sample >> 8;
+        fifo_high_pending = true;
+        return sample;
+    }
+
+    if (pointer >= TWI_REGISTERS_SIZE) {
+        return 0xFF;
+    }
+    uint8_t value = pointer == TWI_REG_FIFO_COUNT
+        ? twi_fifo_ring_count(&fifo)
+        : registers.bytes[pointer];
+    pointer += 1;
+    return value;
+}
+
+static void write_register(uint8_t value) {
+    if (pointer >= TWI_REG_SAMPLING_RATE && pointer < TWI_REGISTERS_SIZE) {
+        registers.bytes[pointer] = value;
+        config_pending |= 1 << (pointer - TWI_REG_SAMPLING_RATE);
+        config_written = true;
+    }
+    pointer += 1;
+}
+
+
+// Interrupção que é disparada a cada passo de uma transação no barramento,
+// identificado pelo código de status do TWSR
+ISR(TWI_vect) {
+    // TWINT fica setado (e o barramento parado) até ser escrito 1 no fim,
+    // então a interrupção é mascarada antes de aninhar (ver `interrupts.h`)
+    TWCR = TWCR_SLAVE & ~(1<<TWINT | 1<<TWIE);
+    INTERRUPT_NEST();
+
+    uint8_t control = TWCR_SLAVE;
+    switch (TWSR & 0b11111000) {
+        case 0x60:
+            // Endereço recebido, para escrita: o próximo byte é o endereço
+            // do registrador
+            power_require(POWER_TWI);
+            pointer_received = false;
+            break;
+
+        case 0x80:
+            // Byte de dados recebido
+            if (pointer_received) {
+                write_register(TWDR);
+            } else {
+                pointer = TWDR;
+                pointer_received = true;
+                fifo_high_pending = false;
+            }
+            break;
+
+        case 0xA8:
+            // Endereço recebido, para leitura
+            power_require(POWER_TWI);
+            reading = true;
+            // Fallthrough
+        case 0xB8:
+            // Byte transmitido e reconhecido pelo mestre: envia o próximo
+            TWDR = read_register();
+            break;
+
+        case 0xA0:
+            // Stop ou repeated start: fim da escrita
+            if (config_written) {
+                config_written = false;
+                scheduler_post(EVENT_TWI);
+            }
+            power_release(POWER_TWI);
+            break;
+
+        case 0xC0:
+        case 0xC8:
+            // Fim da leitura (o mestre não reconheceu o último byte)
+            reading = false;
+            power_release(POWER_TWI);
+            break;
+
+        case 0x00:
+            // Erro no barramento: libera as linhas com um stop interno
+            reading = false;
+            power_release(POWER_TWI);
+            control |= 1<<TWSTO;
+            break;
+
+        default:
+            // Demais estados (chamada geral, que não é habilitada) são ignorados
+            break;
+    }
+
+    INTERRUPT_UNNEST();
+    TWCR = control;
+}
+
+
+void twi_init(uint8_t channels) {
+    registers.fields.id = TWI_ID;
+    registers.fields.version = TWI_VERSION;
+    registers.fields.channels = channels;
+
+    // O TWI é desligado pelo PRR em `power_init`
+    power_twi_enable();
+
+    // Endereço de 7 bits, sem responder à chamada geral
+    TWAR = REG_CONFIG(TWAR, REG_FIELD(TWAR_TWA, TWI_ADDRESS), REG_FIELD(TWAR_TWGCE, 0));
+    TWCR = TWCR_SLAVE;
+}
+
+void twi_add_sample(uint8_t channel, uint16_t sample) {
+    samples += 1;
+    if (!twi_fifo_ring_push(&fifo, sample)) {
+        fifo_dropped += 1;
+    }
+
+    // Durante uma leitura do mestre, o mapa não é alterado, e é atualizado
+    // na próxima amostra
+    ATOMIC_BLOCK(ATOMIC_FORCEON) {
+        if (!reading) {
+            registers.fields.sample[channel] = sample;
+            registers.fields.samples = samples;
+            registers.fields.fifo_dropped = fifo_dropped;
+        }
+    }
+}
+
+void twi_read_config(struct twi_config *twi_config) {
+    ATOMIC_BLOCK(ATOMIC_FORCEON) {
+        twi_config->sampling_rate = registers.fields.sampling_rate;
+        twi_config->flags = registers.fields.flags;
+        twi_config->control = registers.fields.control;
+        config_pending = 0;
+    }
+}
+
+void twi_publish_config(uint8_t control) {
+    const uint8_t values[TWI_REGISTERS_SIZE - TWI_REG_SAMPLING_RATE] = {
+        config.sampling_rate, config.sampling_rate >> 8, config.flags, control,
+    };
+    ATOMIC_BLOCK(ATOMIC_FORCEON) {
+        for (uint8_t i = 0; i < sizeof(values); ++i) {
+            if (!(config_pending & 1<<i)) {
+                registers.bytes[TWI_REG_SAMPLING_RATE + i] = values[i];
+            }
+        }
+    }
+}
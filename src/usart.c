@@ -0,0 +1,337 @@
+#include "usart.h"
+
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#include <util/atomic.h>
+
+#include "config.h"
+#include "interrupts.h"
+#include "power.h"
+#include "reg.h"
+#include "ring.h"
+#include "scheduler.h"
+
+
+const uint8_t digits[10] = {
+    '0', '1', '2', '3', '4', '5', '6', '7', '8', '9',
+};
+
+
+// Filas de recepção e de transmissão (uma por canal)
+RING_DEFINE(usart_rx_ring, uint8_t, 16)
+RING_DEFINE(usart_tx_ring, uint8_t, 64)
+RING_DEFINE(usart_control_ring, uint8_t, 32)
+
+static struct usart_rx_ring rx_ring;
+static struct usart_tx_ring tx_ring;
+static struct usart_control_ring control_ring;
+
+// Canal do último byte transmitido (nenhum no início, para que o primeiro
+// byte seja sempre precedido do marcador)
+static uint8_t wire_channel = 0xFF;
+
+#ifdef MULTIDROP
+uint16_t usart_dropped = 0;
+#endif
+
+#ifdef MULTIDROP
+// Indica se a placa foi endereçada pelo último frame de endereço, se ela está
+// transmitindo uma resposta, e quantos bytes ainda podem ser transmitidos
+// nessa resposta
+static bool bus_selected = false;
+static volatile bool bus_granted = false;
+static uint8_t bus_budget;
+
+// Valor do UCSR0A, com velocidade dobrada, recebendo só os frames de endereço
+// (`ignore_data`) ou todos. As flags são escritas como 0, o que não limpa TXC0
+#define UCSR0A_CONFIG(ignore_data) REG_CONFIG(UCSR0A,                           \
+    REG_FIELD(UCSR0A_U2X0, 1),                                                  \
+    REG_FIELD(UCSR0A_MPCM0, ignore_data))
+
+// Trata um frame de endereço do host. Chamada com as interrupções desabilitadas
+static inline void bus_address(uint8_t address) {
+    bus_selected = address == config.bus_address;
+    if (bus_selected || address == USART_BUS_BROADCAST) {
+        UCSR0A = UCSR0A_CONFIG(0);
+    } else {
+        UCSR0A = UCSR0A_CONFIG(1);
+    }
+}
+
+// Inicia a resposta a uma consulta do host, com os bytes que estão nas filas
+// agora e os marcadores dos dois canais. Chamada com as interrupções
+// desabilitadas
+static inline void bus_grant(void) {
+    if (!bus_selected || bus_granted) {
+        return;
+    }
+    bus_budget = usart_control_ring_count(&control_ring) + usart_tx_ring_count(&tx_ring) + 2;
+    bus_granted = true;
+    // A resposta é independente das anteriores, e começa pelo marcador
+    wire_channel = 0xFF;
+    PORTD |= 1<<PORTD2;
+    power_require(POWER_USART_TX);
+    UCSR0B |= 1<<UDRIE0;
+}
+#endif
+
+
+// Escreve um byte no UDR0 e limpa a flag TXC0, que pode ter ficado setada no
+// fim de uma transmissão anterior, para que a interrupção de transmissão
+// concluída só aconteça depois deste byte. O UCSR0A é reescrito preservando
+// U2X0 e MPCM0 (as outras flags são só de leitura), com as interrupções
+// desabilitadas, para que a limpeza aconteça antes do fim do frame e não
+// desfaça uma mudança do MPCM0 pela interrupção de recepção
+static inline void load_data(uint8_t data) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        UDR0 = data;
+        UCSR0A = (UCSR0A & (1<<U2X0 | 1<<MPCM0)) | 1<<TXC0;
+    }
+}
+
+// Interrupção que é disparada quando é recebido um byte pela serial
+ISR(USART_RX_vect) {
+#ifdef MULTIDROP
+    // O nono bit deve ser lido antes do UDR0
+    bool address = UCSR0B & (1<<RXB80);
+#endif
+    // A leitura do byte limpa a flag, e a interrupção fica mascarada até o fim
+    // para que a rotina não seja reentrada (ver `interrupts.h`)
+    uint8_t data = UDR0;
+#ifdef MULTIDROP
+    // Endereços e consultas do barramento são tratados aqui mesmo, pois a
+    // resposta não pode esperar o contexto principal (que pode estar esperando
+    // espaço na fila de transmissão)
+    if (address) {
+        bus_address(data);
+        return;
+    }
+    if (data == USART_BUS_POLL) {
+        bus_grant();
+        return;
+    }
+#endif
+    UCSR0B &= ~(1<<RXCIE0);
+    INTERRUPT_NEST();
+
+    // O byte é descartado caso a fila esteja cheia
+    usart_rx_ring_push(&rx_ring, data);
+    scheduler_post(EVENT_COMMAND);
+
+    INTERRUPT_UNNEST();
+    UCSR0B |= 1<<RXCIE0;
+}
+
+// Interrupção que é disparada quando o buffer de transmissão fica vazio
+ISR(USART_UDRE_vect) {
+    // A flag UDRE0 fica setada enquanto o buffer estiver vazio, então a
+    // interrupção é mascarada antes de aninhar (ver `interrupts.h`)
+    UCSR0B &= ~(1<<UDRIE0);
+    INTERRUPT_NEST();
+
+    // O canal de controle tem prioridade
+    uint8_t data;
+    uint8_t channel;
+    bool empty = false;
+    if (usart_control_ring_peek(&control_ring, &data)) {
+        channel = USART_CHANNEL_CONTROL;
+    } else if (usart_tx_ring_peek(&tx_ring, &data)) {
+        channel = USART_CHANNEL_DATA;
+    } else {
+        empty = true;
+    }
+#ifdef MULTIDROP
+    // A resposta termina quando as filas esvaziam, ou quando os bytes que
+    // estavam nelas na consulta já foram transmitidos
+    if (bus_budget == 0) {
+        empty = true;
+    }
+#endif
+
+    if (!empty) {
+        if (channel != wire_channel) {
+            // Na troca de canal, o marcador é transmitido antes, e o byte
+            // fica na fila até a próxima interrupção
+            wire_channel = channel;
+            load_data(USART_CHANNEL_MARKER | channel);
+        } else {
+            load_data(data);
+            if (channel == USART_CHANNEL_CONTROL) {
+                usart_control_ring_pop(&control_ring, &data);
+            } else {
+                usart_tx_ring_pop(&tx_ring, &data);
+            }
+        }
+#ifdef MULTIDROP
+        bus_budget -= 1;
+#endif
+    }
+#ifdef MULTIDROP
+    else if (bus_granted) {
+        // Fim da resposta. O driver é desligado quando este byte terminar de
+        // sair do shift register
+        load_data(USART_BUS_END);
+        bus_granted = false;
+    }
+#endif
+
+    INTERRUPT_UNNEST();
+    if (empty) {
+        // Filas vazias: esta interrupção continua desabilitada, e é esperado o
+        // último byte sair do shift register
+        UCSR0B |= 1<<TXCIE0;
+    } else {
+        UCSR0B |= 1<<UDRIE0;
+    }
+}
+
+// Interrupção que é disparada quando a transmissão é concluída
+ISR(USART_TX_vect) {
+    UCSR0B &= ~(1<<TXCIE0);
+#ifdef MULTIDROP
+    // Fim da resposta: o barramento fica livre para a próxima placa, e os
+    // bytes que restarem nas filas esperam a próxima consulta
+    PORTD &= ~(1<<PORTD2);
+    power_release(POWER_USART_TX);
+#else
+    // Caso um novo byte tenha sido inserido nesse meio tempo, a USART continua
+    // requisitada, e será liberada ao fim da próxima transmissão
+    if (usart_tx_ring_count(&tx_ring) == 0 && usart_control_ring_count(&control_ring) == 0) {
+        power_release(POWER_USART_TX);
+    }
+#endif
+}
+
+
+void USART_init(void) {
+#ifdef MULTIDROP
+    // Modo assíncrono, velocidade de transmissão dobrada
+    // 9 bits de dados por frame, sem bit de paridade, 1 bit de parada
+    // Modo multiprocessador: só os frames de endereço são recebidos
+    // Habilita as funções de transmissor e receptor
+    // Habilita interrupção ao concluir uma recepção
+    // Driver do transceptor RS-485 (DE, em PD2) desligado
+    DDRD |= 1<<DDD2;
+    PORTD &= ~(1<<PORTD2);
+    UCSR0A = UCSR0A_CONFIG(1);
+    UCSR0B = REG_CONFIG(UCSR0B,
+        REG_FIELD(UCSR0B_RXCIE0, 1),
+        REG_FIELD(UCSR0B_RXEN0, 1),
+        REG_FIELD(UCSR0B_TXEN0, 1),
+        REG_FIELD(UCSR0B_UCSZ02, 1));
+#else
+    // Modo assíncrono, velocidade de transmissão dobrada
+    // 8 bits de dados por frame, sem bit de paridade, 1 bit de parada
+    // Habilita as funções de transmissor e receptor
+    // Habilita interrupção ao concluir uma recepção
+    UCSR0A = REG_CONFIG(UCSR0A, REG_FIELD(UCSR0A_U2X0, 1));
+    UCSR0B = REG_CONFIG(UCSR0B,
+        REG_FIELD(UCSR0B_RXCIE0, 1),
+        REG_FIELD(UCSR0B_RXEN0, 1),
+        REG_FIELD(UCSR0B_TXEN0, 1));
+#endif
+    UCSR0C = REG_CONFIG(UCSR0C,
+        REG_FIELD(UCSR0C_UMSEL0, USART_MODE_ASYNC),
+        REG_FIELD(UCSR0C_UPM0, USART_PARITY_NONE),
+        REG_FIELD(UCSR0C_USBS0, 0),
+        REG_FIELD(UCSR0C_UCSZ0, USART_CHARACTER_8));
+
+    USART_set_baud_rate(BAUD_RATE);
+}
+
+void USART_set_baud_rate(uint32_t baud_rate) {
+    // Configura o baud rate (8 se refere ao prescaler quando em
+    // modo assíncrono com velocidade de transmissão dobrada)
+    UBRR0 = CPU_CLOCK / 8 / baud_rate - 1;
+}
+
+void USART_flush(void) {
+    // As interrupções de transmissão só são desabilitadas depois que o último
+    // byte sai do shift register
+    while (UCSR0B & (1<<UDRIE0 | 1<<TXCIE0)) { }
+}
+
+bool USART_receive(uint8_t *data) {
+    return usart_rx_ring_pop(&rx_ring, data);
+}
+
+// Inicia o envio da fila de transmissão, caso ainda não esteja em andamento.
+// No barramento multiponto, o envio só começa na consulta do host (ver
+// `bus_grant`)
+static void start_transmission(void) {
+#ifndef MULTIDROP
+    power_require(POWER_USART_TX);
+    // UCSR0B também é alterado pelas interrupções de transmissão
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        UCSR0B |= 1<<UDRIE0;
+    }
+#endif
+}
+
+void USART_transmit(uint8_t channel, uint8_t data) {
+#ifdef MULTIDROP
+    // No barramento, a fila só esvazia quando o host consulta a placa, então
+    // o byte é descartado em vez de esperar
+    bool queued = channel == USART_CHANNEL_CONTROL
+        ? usart_control_ring_push(&control_ring, data)
+        : usart_tx_ring_push(&tx_ring, data);
+    if (!queued) {
+        usart_dropped += 1;
+    }
+#else
+    // Espera que haja espaço na fila de transmissão
+    if (channel == USART_CHANNEL_CONTROL) {
+        while (!usart_control_ring_push(&control_ring, data)) { }
+    } else {
+        while (!usart_tx_ring_push(&tx_ring, data)) { }
+    }
+    start_transmission();
+#endif
+}
+
+bool USART_try_transmit(uint8_t channel, const uint8_t *data, uint8_t n) {
+    if (channel == USART_CHANNEL_CONTROL) {
+        if (usart_control_ring_free(&control_ring) < n) {
+            return false;
+        }
+        usart_control_ring_push_bulk(&control_ring, data, n);
+    } else {
+        if (usart_tx_ring_free(&tx_ring) < n) {
+            return false;
+        }
+        usart_tx_ring_push_bulk(&tx_ring, data, n);
+    }
+    start_transmission();
+    return true;
+}
+
+void USART_transmit_decimal(uint8_t channel, uint32_t value) {
+    uint8_t chars[10];
+    uint8_t length = 0;
+    do {
+        chars[length] = digits[value%10];
+        value /= 10;
+        length += 1;
+    } while (value != 0);
+
+    while (length > 0) {
+        length -= 1;
+        USART_transmit(channel, chars[length]);
+    }
+}
+
+void USART_transmit_string(uint8_t channel, const char *text) {
+    while (*text != '\0') {
+        USART_transmit(channel, *text);
+        text += 1;
+    }
+}
+
+void USART_transmit_report(uint8_t channel, const char *name, uint32_t value) {
+    USART_transmit(channel, '#');
+    USART_transmit_string(channel, name);
+    USART_transmit(channel, ' ');
+    USART_transmit_decimal(channel, value);
+    USART_transmit(channel, '\r');
+    USART_transmit(channel, '\n');
+}
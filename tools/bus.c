@@ -0,0 +1,329 @@
+/**
+ * Teste do barramento multiponto (ver `include/usart.h`) com várias instâncias
+ * do firmware no simavr.
+ *
+ * Cada placa é uma instância do simavr com o mesmo firmware, compilado com
+ * `-DMULTIDROP` (ambiente `multidrop` do PlatformIO). As instâncias são
+ * executadas em passos de `STEP_CYCLES` ciclos, todas com o mesmo relógio, e
+ * ligadas a um barramento simulado no lugar do RS-485:
+ *
+ * - os frames do host (9 bits, com o nono bit nos endereços) chegam a todas
+ *   as placas, que os filtram pela USART no modo multiprocessador;
+ * - os bytes transmitidos por uma placa chegam só ao host. Como o /RE do
+ *   transceptor é ligado ao DE, uma placa não recebe a própria resposta, e as
+ *   outras descartariam os frames de dados de qualquer forma;
+ * - o pino DE (PD2) de cada placa é acompanhado. Um byte transmitido com o DE
+ *   desligado, ou com o DE de outra placa ligado (colisão), é contado como
+ *   erro, assim como um byte de uma placa que não foi consultada.
+ *
+ * O host simulado primeiro dá um endereço a cada placa: com só uma delas
+ * ligada ao barramento, endereça `MULTIDROP_ADDRESS` (o endereço padrão) e
+ * envia o comando 'A' com o endereço 1, 2, 3... Depois, inicia a transmissão
+ * de todas por broadcast e as consulta em sequência, esperando o fim de cada
+ * resposta (ou `POLL_TIMEOUT_CYCLES`) antes de consultar a próxima. As linhas
+ * do canal de dados de cada placa são escritas na saída padrão precedidas do
+ * endereço, e as do canal de controle na saída de erro. No final, são
+ * informadas as estatísticas de cada placa, e o programa termina com erro
+ * caso alguma placa tenha colidido, transmitido sem ser consultada ou deixado
+ * de responder.
+ *
+ * O simavr deve emular os frames de 9 bits da USART (o nono bit no bit 8 do
+ * valor das IRQs de entrada e de saída) e o filtro do modo multiprocessador.
+ *
+ * Compilação (requer o simavr e a libelf instalados):
+ *
+ *     cc -O2 -o bus tools/bus.c -lsimavr -lelf
+ *
+ * Uso:
+ *
+ *     bus <firmware.elf> [-n placas] [-c ciclos] [-s comandos]
+ *
+ *     -n  quantidade de placas no barramento (padrão: 4)
+ *     -c  quantidade de ciclos simulados (padrão: 10 segundos a 1 MHz)
+ *     -s  comandos enviados por broadcast depois do endereçamento (padrão:
+ *         "1", que inicia a transmissão)
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <simavr/sim_avr.h>
+#include <simavr/sim_elf.h>
+#include <simavr/sim_io.h>
+#include <simavr/sim_irq.h>
+#include <simavr/avr_adc.h>
+#include <simavr/avr_ioport.h>
+#include <simavr/avr_uart.h>
+
+
+// Frequência da CPU (em Hz)
+#define CPU_CLOCK 1000000
+
+// Tensões de alimentação e de referência (em mV), e a tensão na entrada ADC0
+#define VCC 5000
+#define ADC_MILLIVOLTS 2500
+
+// Quantidade máxima de placas (os endereços vão de 1 a 255)
+#define NODES_MAX 32
+
+// Endereço padrão das placas, broadcast, consulta e fim da resposta (ver
+// `include/config.h` e `include/usart.h`)
+#define MULTIDROP_ADDRESS 1
+#define BUS_BROADCAST 0
+#define BUS_POLL 0x05
+#define BUS_END 0x04
+
+// Nono bit dos frames de endereço, no valor das IRQs da USART
+#define BUS_ADDRESS_BIT 0x100
+
+// Marcador de troca de canal da serial e os canais (ver `include/usart.h`)
+#define STREAM_MARKER 0x80
+#define STREAM_CHANNEL_DATA 0
+#define STREAM_CHANNEL_CONTROL 1
+
+// Passo da simulação conjunta, tempo dado a cada placa para tratar o comando
+// de endereço, e tempo máximo de espera por uma resposta (em ciclos)
+#define STEP_CYCLES 20
+#define SETUP_CYCLES 50000
+#define POLL_TIMEOUT_CYCLES 200000
+
+// Tamanho máximo de uma linha de uma placa
+#define LINE_MAX 128
+
+
+// Placa simulada, com o estado do seu pino DE, a linha sendo recebida de cada
+// canal e as estatísticas
+struct node {
+    avr_t *avr;
+    int state;
+    uint8_t address;
+    avr_irq_t *uart_input;
+    bool driver_enabled;
+    int channel;
+    char lines[2][LINE_MAX];
+    size_t lengths[2];
+    uint64_t polls;
+    uint64_t responses;
+    uint64_t timeouts;
+    uint64_t bytes;
+    uint64_t data_lines;
+    uint64_t errors;
+};
+
+static struct node nodes[NODES_MAX];
+static int nodes_number = 4;
+
+// Placa consultada (-1 quando nenhuma), o ciclo da consulta e se a resposta
+// terminou
+static int polled = -1;
+static avr_cycle_count_t poll_cycle;
+static bool response_done;
+
+// Ciclo atual do barramento (todas as placas estão nele ao fim de cada passo)
+static avr_cycle_count_t bus_cycle = 0;
+
+
+// Envia um frame do host a uma placa, ou a todas (`target` -1)
+static void host_send(int target, uint16_t frame) {
+    for (int i = 0; i < nodes_number; ++i) {
+        if (target < 0 || target == i) {
+            avr_raise_irq(nodes[i].uart_input, frame);
+        }
+    }
+}
+
+// Envia um frame de endereço seguido de um texto em frames de dados
+static void host_send_text(int target, uint8_t address, const char *text) {
+    host_send(target, BUS_ADDRESS_BIT | address);
+    for (const char *c = text; *c != '\0'; ++c) {
+        host_send(target, (uint8_t) *c);
+    }
+}
+
+// Acompanha o pino DE de uma placa
+static void driver_output(struct avr_irq_t *irq, uint32_t value, void *param) {
+    (void) irq;
+    struct node *node = param;
+    node->driver_enabled = value != 0;
+}
+
+// Recebe um byte transmitido por uma placa, separando as linhas de cada canal
+static void uart_output(struct avr_irq_t *irq, uint32_t value, void *param) {
+    (void) irq;
+    struct node *node = param;
+    int index = (int) (node - nodes);
+
+    bool collision = false;
+    for (int i = 0; i < nodes_number; ++i) {
+        collision |= i != index && nodes[i].driver_enabled;
+    }
+    if (index != polled || !node->driver_enabled || collision || (value & BUS_ADDRESS_BIT)) {
+        fprintf(stderr, "placa %u: byte %03" PRIx32 " no ciclo %" PRIu64 " %s\n",
+            node->address, value, bus_cycle,
+            index != polled ? "sem consulta" : !node->driver_enabled ? "com o DE desligado"
+                : collision ? "em colisão" : "com o nono bit");
+        node->errors += 1;
+    }
+
+    uint8_t data = value;
+    node->bytes += 1;
+    if (data == BUS_END && index == polled) {
+        response_done = true;
+        node->responses += 1;
+        return;
+    }
+    if (data & STREAM_MARKER) {
+        node->channel = data & ~STREAM_MARKER;
+        return;
+    }
+
+    int channel = node->channel == STREAM_CHANNEL_CONTROL ? 1 : 0;
+    char *line = node->lines[channel];
+    if (node->lengths[channel] + 1 < LINE_MAX) {
+        line[node->lengths[channel]++] = data;
+    }
+    if (data == '\n') {
+        line[node->lengths[channel]] = '\0';
+        FILE *output = channel ? stderr : stdout;
+        fprintf(output, "%u %s", node->address, line);
+        node->lengths[channel] = 0;
+        node->data_lines += !channel;
+    }
+}
+
+// Executa todas as placas até o ciclo `cycle`
+static void run_until(avr_cycle_count_t cycle) {
+    for (int i = 0; i < nodes_number; ++i) {
+        struct node *node = &nodes[i];
+        while (node->avr->cycle < cycle && node->state != cpu_Done && node->state != cpu_Crashed) {
+            node->state = avr_run(node->avr);
+        }
+    }
+    bus_cycle = cycle;
+}
+
+// Executa a simulação por `cycles` ciclos a partir do ciclo atual
+static void run_for(avr_cycle_count_t cycles) {
+    avr_cycle_count_t end = bus_cycle + cycles;
+    while (bus_cycle < end) {
+        run_until(bus_cycle + STEP_CYCLES);
+    }
+}
+
+
+int main(int argc, char **argv) {
+    const char *firmware_path = NULL;
+    avr_cycle_count_t cycles = 10 * (avr_cycle_count_t) CPU_CLOCK;
+    const char *commands = "1";
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-n") == 0 && i+1 < argc) {
+            nodes_number = strtol(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-c") == 0 && i+1 < argc) {
+            cycles = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-s") == 0 && i+1 < argc) {
+            commands = argv[++i];
+        } else if (firmware_path == NULL) {
+            firmware_path = argv[i];
+        } else {
+            firmware_path = NULL;
+            break;
+        }
+    }
+    if (firmware_path == NULL || nodes_number < 1 || nodes_number > NODES_MAX) {
+        fprintf(stderr, "uso: %s <firmware.elf> [-n placas] [-c ciclos] [-s comandos]\n", argv[0]);
+        return 1;
+    }
+
+    elf_firmware_t firmware;
+    memset(&firmware, 0, sizeof(firmware));
+    if (elf_read_firmware(firmware_path, &firmware) != 0) {
+        fprintf(stderr, "não foi possível ler %s\n", firmware_path);
+        return 1;
+    }
+
+    for (int i = 0; i < nodes_number; ++i) {
+        struct node *node = &nodes[i];
+        node->avr = avr_make_mcu_by_name("atmega328p");
+        if (node->avr == NULL) {
+            fprintf(stderr, "simavr sem suporte ao atmega328p\n");
+            return 1;
+        }
+        avr_init(node->avr);
+        avr_load_firmware(node->avr, &firmware);
+        node->avr->frequency = CPU_CLOCK;
+        node->avr->vcc = VCC;
+        node->avr->avcc = VCC;
+        node->avr->aref = VCC;
+        node->state = cpu_Running;
+        node->address = MULTIDROP_ADDRESS;
+        node->channel = STREAM_CHANNEL_DATA;
+
+        // Desliga a saída padrão do simavr para a serial, que vai para o
+        // barramento
+        uint32_t uart_flags = 0;
+        avr_ioctl(node->avr, AVR_IOCTL_UART_GET_FLAGS('0'), &uart_flags);
+        uart_flags &= ~AVR_UART_FLAG_STDIO;
+        avr_ioctl(node->avr, AVR_IOCTL_UART_SET_FLAGS('0'), &uart_flags);
+
+        avr_irq_register_notify(
+            avr_io_getirq(node->avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_OUTPUT),
+            uart_output, node);
+        avr_irq_register_notify(
+            avr_io_getirq(node->avr, AVR_IOCTL_IOPORT_GETIRQ('D'), 2),
+            driver_output, node);
+        node->uart_input = avr_io_getirq(node->avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_INPUT);
+
+        avr_raise_irq(avr_io_getirq(node->avr, AVR_IOCTL_ADC_GETIRQ, ADC_IRQ_ADC0), ADC_MILLIVOLTS);
+    }
+
+    // Endereçamento: cada placa recebe o seu endereço sozinha, pelo endereço
+    // padrão
+    for (int i = 0; i < nodes_number; ++i) {
+        char command[8];
+        snprintf(command, sizeof(command), "A%d\r", i + 1);
+        host_send_text(i, MULTIDROP_ADDRESS, command);
+        run_for(SETUP_CYCLES);
+        nodes[i].address = i + 1;
+    }
+
+    // Comandos para todas as placas, e consultas em sequência
+    host_send_text(-1, BUS_BROADCAST, commands);
+    int next = 0;
+    while (bus_cycle < cycles) {
+        if (polled < 0) {
+            polled = next;
+            next = (next + 1) % nodes_number;
+            response_done = false;
+            poll_cycle = bus_cycle;
+            nodes[polled].polls += 1;
+            host_send(-1, BUS_ADDRESS_BIT | nodes[polled].address);
+            host_send(-1, BUS_POLL);
+        } else if (response_done) {
+            polled = -1;
+        } else if (bus_cycle - poll_cycle > POLL_TIMEOUT_CYCLES) {
+            nodes[polled].timeouts += 1;
+            polled = -1;
+        }
+        run_for(STEP_CYCLES);
+    }
+
+    fflush(stdout);
+    fprintf(stderr, "\n%-8s %8s %10s %8s %10s %8s %6s\n",
+        "placa", "consultas", "respostas", "sem resp", "bytes", "linhas", "erros");
+    bool failed = false;
+    for (int i = 0; i < nodes_number; ++i) {
+        struct node *node = &nodes[i];
+        fprintf(stderr, "%-8u %8" PRIu64 " %10" PRIu64 " %8" PRIu64 " %10" PRIu64 " %8" PRIu64 " %6" PRIu64 "%s\n",
+            node->address, node->polls, node->responses, node->timeouts,
+            node->bytes, node->data_lines, node->errors,
+            node->state == cpu_Crashed ? "  (travou)" : "");
+        failed |= node->errors != 0 || node->timeouts != 0 || node->state == cpu_Crashed;
+    }
+
+    return failed;
+}
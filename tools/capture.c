@@ -0,0 +1,671 @@
+/**
+ * Formato de captura do stream de amostras no host, em colunas e em blocos
+ * (chunks), com um índice no final do arquivo.
+ *
+ * O stream da serial ("0123\r\n" por amostra) é lento de interpretar e ocupa
+ * 6 bytes por amostra. Neste formato, as amostras de cada canal são agrupadas
+ * em chunks de até `CHUNK_SAMPLES` amostras. Cada chunk guarda a primeira
+ * amostra e as diferenças entre amostras consecutivas, em zigzag, com a menor
+ * quantidade de bits que comporta a maior diferença do chunk. Um sinal que
+ * varia pouco ocupa poucos bits por amostra.
+ *
+ * Todos os valores são little-endian. O arquivo é formado por:
+ *
+ *     cabeçalho (32 bytes)
+ *         0   "ADCCAP1\0"
+ *         8   versão (u16) e quantidade de canais (u16)
+ *         12  taxa de amostragem em Hz (u32, 0 se desconhecida)
+ *         16  início da captura, em µs desde a época Unix (u64)
+ *         24  reservado
+ *
+ *     chunks, em qualquer ordem de canal (32 bytes + dados cada)
+ *         0   "CHNK"
+ *         4   canal (u16), bits por diferença (u8), reservado (u8)
+ *         8   quantidade de amostras (u32)
+ *         12  tamanho dos dados (u32)
+ *         16  sequência da primeira amostra (u64)
+ *         24  primeira amostra (u16), reservado
+ *         32  diferenças empacotadas, a partir do bit menos significativo
+ *
+ *     índice, uma entrada por chunk (48 bytes cada)
+ *         0   posição do chunk no arquivo (u64)
+ *         8   sequência da primeira e da última amostra (u64, u64)
+ *         24  instante da primeira e da última amostra, em µs (u64, u64)
+ *         40  canal (u16), reservado, quantidade de amostras (u32)
+ *
+ *     rodapé (24 bytes)
+ *         0   posição do índice (u64)
+ *         8   quantidade de entradas do índice (u64)
+ *         16  "ADCIDX1\0"
+ *
+ * Para abrir o arquivo, basta mapeá-lo na memória e ler o rodapé, sem
+ * percorrer as amostras. A busca por sequência ou por instante é uma busca
+ * binária no índice, seguida da decodificação de um único chunk, então leva o
+ * mesmo tempo em uma captura de horas e em uma de segundos. Caso a captura
+ * tenha sido interrompida antes de o índice ser escrito, ele é reconstruído
+ * percorrendo os cabeçalhos dos chunks.
+ *
+ * Compilação:
+ *
+ *     cc -O2 -o capture tools/capture.c
+ *
+ * Uso:
+ *
+ *     capture record <entrada> <arquivo> [-r taxa] [-b baud]
+ *     capture info <arquivo>
+ *     capture dump <arquivo> [-c canal] [-s sequência | -t µs] [-n quantidade]
+ *
+ * `record` lê o stream de texto de `entrada` (a serial, um log antigo, ou "-"
+ * para a entrada padrão) e grava a captura. Os canais da serial são separados
+ * pelos marcadores (ver `include/usart.h`): as respostas do canal de controle
+ * são escritas na saída de erro, e as linhas "#..." do canal de dados são
+ * ignoradas, exceto o cabeçalho "#stream" (ver `src/main.c`): só são gravadas
+ * as amostras das linhas com a codificação "raw", e a taxa do primeiro
+ * cabeçalho vai para o cabeçalho do arquivo. Sem `-r`, o instante de cada
+ * amostra é o da sua recepção; com `-r`, ele é calculado pela taxa de
+ * amostragem, o que serve para converter logs antigos, que não têm o
+ * cabeçalho do stream. Se `entrada` for um terminal, ele é configurado no modo raw
+ * com o baud rate `-b` (padrão: 9600). `info` lista o índice, e `dump` escreve
+ * as amostras a partir da posição pedida, uma por linha.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+
+// Identificadores das partes do arquivo
+#define FILE_MAGIC "ADCCAP1\0"
+#define CHUNK_MAGIC "CHNK"
+#define INDEX_MAGIC "ADCIDX1\0"
+
+#define FILE_VERSION 1
+
+// Tamanhos das partes do arquivo
+#define HEADER_SIZE 32
+#define CHUNK_HEADER_SIZE 32
+#define INDEX_ENTRY_SIZE 48
+#define FOOTER_SIZE 24
+
+// Quantidade máxima de amostras em um chunk
+#define CHUNK_SAMPLES 4096
+
+// Quantidade de canais suportada pelo gravador
+#define CHANNELS_MAX 8
+
+// Marcador de troca de canal da serial e os canais (ver `include/usart.h`)
+#define STREAM_MARKER 0x80
+#define STREAM_CHANNEL_DATA 0
+#define STREAM_CHANNEL_CONTROL 1
+
+
+// Entrada do índice
+struct index_entry {
+    uint64_t offset;
+    uint64_t first_sequence;
+    uint64_t last_sequence;
+    uint64_t first_time;
+    uint64_t last_time;
+    uint16_t channel;
+    uint32_t count;
+};
+
+
+static void put_u16(uint8_t *p, uint16_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+static void put_u32(uint8_t *p, uint32_t v) {
+    put_u16(p, v);
+    put_u16(p + 2, v >> 16);
+}
+
+static void put_u64(uint8_t *p, uint64_t v) {
+    put_u32(p, v);
+    put_u32(p + 4, v >> 32);
+}
+
+static uint16_t get_u16(const uint8_t *p) {
+    return p[0] | (uint16_t) p[1] << 8;
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+    return get_u16(p) | (uint32_t) get_u16(p + 2) << 16;
+}
+
+static uint64_t get_u64(const uint8_t *p) {
+    return get_u32(p) | (uint64_t) get_u32(p + 4) << 32;
+}
+
+static uint64_t now_microseconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void fail(const char *message) {
+    fprintf(stderr, "%s: %s\n", message, errno != 0 ? strerror(errno) : "formato inválido");
+    exit(1);
+}
+
+
+// Codificação dos chunks
+
+// Diferença em zigzag: 0, -1, 1, -2, 2, ... viram 0, 1, 2, 3, 4, ...
+static uint32_t zigzag(int32_t v) {
+    return (uint32_t) (v << 1) ^ (uint32_t) (v >> 31);
+}
+
+static int32_t unzigzag(uint32_t v) {
+    return (int32_t) (v >> 1) ^ -(int32_t) (v & 1);
+}
+
+// Codifica `count` amostras em `out`, retornando o tamanho dos dados e
+// escrevendo a quantidade de bits por diferença em `bits`
+static size_t encode_chunk(const uint16_t *samples, uint32_t count, uint8_t *out, uint8_t *bits) {
+    uint32_t max = 0;
+    for (uint32_t i = 1; i < count; ++i) {
+        uint32_t z = zigzag((int32_t) samples[i] - samples[i-1]);
+        if (z > max) {
+            max = z;
+        }
+    }
+    *bits = 0;
+    while (max >> *bits) {
+        *bits += 1;
+    }
+
+    size_t size = ((size_t) (count - 1) * *bits + 7) / 8;
+    memset(out, 0, size);
+    size_t bit = 0;
+    for (uint32_t i = 1; i < count; ++i) {
+        uint32_t z = zigzag((int32_t) samples[i] - samples[i-1]);
+        for (uint8_t b = 0; b < *bits; ++b, ++bit) {
+            if (z >> b & 1) {
+                out[bit / 8] |= 1 << bit % 8;
+            }
+        }
+    }
+    return size;
+}
+
+// Decodifica as amostras do chunk que começa em `chunk`
+static void decode_chunk(const uint8_t *chunk, uint16_t *samples) {
+    uint8_t bits = chunk[6];
+    uint32_t count = get_u32(chunk + 8);
+    const uint8_t *data = chunk + CHUNK_HEADER_SIZE;
+
+    samples[0] = get_u16(chunk + 24);
+    size_t bit = 0;
+    for (uint32_t i = 1; i < count; ++i) {
+        uint32_t z = 0;
+        for (uint8_t b = 0; b < bits; ++b, ++bit) {
+            z |= (uint32_t) (data[bit / 8] >> bit % 8 & 1) << b;
+        }
+        samples[i] = samples[i-1] + unzigzag(z);
+    }
+}
+
+
+// Gravação
+
+// Chunk sendo montado para cada canal
+static struct {
+    uint16_t samples[CHUNK_SAMPLES];
+    uint32_t count;
+    uint64_t first_sequence;
+    uint64_t first_time;
+    uint64_t last_time;
+} pending[CHANNELS_MAX];
+
+static struct index_entry *entries = NULL;
+static size_t entries_count = 0;
+static size_t entries_capacity = 0;
+
+static volatile sig_atomic_t interrupted = 0;
+
+static void on_interrupt(int signal) {
+    (void) signal;
+    interrupted = 1;
+}
+
+static void write_chunk(FILE *file, uint16_t channel) {
+    if (pending[channel].count == 0) {
+        return;
+    }
+
+    static uint8_t data[CHUNK_SAMPLES * 4];
+    uint8_t bits;
+    size_t size = encode_chunk(pending[channel].samples, pending[channel].count, data, &bits);
+
+    uint8_t header[CHUNK_HEADER_SIZE] = { 0 };
+    memcpy(header, CHUNK_MAGIC, 4);
+    put_u16(header + 4, channel);
+    header[6] = bits;
+    put_u32(header + 8, pending[channel].count);
+    put_u32(header + 12, size);
+    put_u64(header + 16, pending[channel].first_sequence);
+    put_u16(header + 24, pending[channel].samples[0]);
+
+    if (entries_count == entries_capacity) {
+        entries_capacity = entries_capacity ? 2 * entries_capacity : 1024;
+        entries = realloc(entries, entries_capacity * sizeof(*entries));
+        if (entries == NULL) {
+            fail("memória insuficiente");
+        }
+    }
+    entries[entries_count++] = (struct index_entry) {
+        .offset = ftell(file),
+        .first_sequence = pending[channel].first_sequence,
+        .last_sequence = pending[channel].first_sequence + pending[channel].count - 1,
+        .first_time = pending[channel].first_time,
+        .last_time = pending[channel].last_time,
+        .channel = channel,
+        .count = pending[channel].count,
+    };
+
+    if (fwrite(header, CHUNK_HEADER_SIZE, 1, file) != 1
+            || (size > 0 && fwrite(data, size, 1, file) != 1)) {
+        fail("erro na escrita");
+    }
+    // Um chunk completo fica no disco mesmo que a captura seja interrompida
+    fflush(file);
+
+    pending[channel].first_sequence += pending[channel].count;
+    pending[channel].count = 0;
+}
+
+static void add_sample(FILE *file, uint16_t channel, uint16_t sample, uint64_t time) {
+    if (pending[channel].count == 0) {
+        pending[channel].first_time = time;
+    }
+    pending[channel].samples[pending[channel].count++] = sample;
+    pending[channel].last_time = time;
+    if (pending[channel].count == CHUNK_SAMPLES) {
+        write_chunk(file, channel);
+    }
+}
+
+static void write_index(FILE *file) {
+    uint64_t index_offset = ftell(file);
+    for (size_t i = 0; i < entries_count; ++i) {
+        uint8_t e[INDEX_ENTRY_SIZE] = { 0 };
+        put_u64(e, entries[i].offset);
+        put_u64(e + 8, entries[i].first_sequence);
+        put_u64(e + 16, entries[i].last_sequence);
+        put_u64(e + 24, entries[i].first_time);
+        put_u64(e + 32, entries[i].last_time);
+        put_u16(e + 40, entries[i].channel);
+        put_u32(e + 44, entries[i].count);
+        if (fwrite(e, INDEX_ENTRY_SIZE, 1, file) != 1) {
+            fail("erro na escrita");
+        }
+    }
+
+    uint8_t footer[FOOTER_SIZE];
+    put_u64(footer, index_offset);
+    put_u64(footer + 8, entries_count);
+    memcpy(footer + 16, INDEX_MAGIC, 8);
+    if (fwrite(footer, FOOTER_SIZE, 1, file) != 1) {
+        fail("erro na escrita");
+    }
+}
+
+// Configura um terminal no modo raw, com o baud rate dado
+static void configure_terminal(int fd, unsigned long baud) {
+    struct termios tio;
+    if (tcgetattr(fd, &tio) != 0) {
+        fail("não foi possível configurar o terminal");
+    }
+    cfmakeraw(&tio);
+    speed_t speed = baud == 9600 ? B9600 : baud == 19200 ? B19200
+        : baud == 38400 ? B38400 : baud == 57600 ? B57600 : B115200;
+    cfsetispeed(&tio, speed);
+    cfsetospeed(&tio, speed);
+    if (tcsetattr(fd, TCSANOW, &tio) != 0) {
+        fail("não foi possível configurar o terminal");
+    }
+}
+
+// Lê a próxima linha do canal de dados da serial. Os bytes do canal de
+// controle são escritos na saída de erro. Logs antigos, sem marcadores, são
+// inteiramente do canal de dados
+static bool read_data_line(FILE *input, char *line, size_t size) {
+    static int channel = STREAM_CHANNEL_DATA;
+    size_t length = 0;
+    int c;
+    while ((c = getc(input)) != EOF) {
+        if (c & STREAM_MARKER) {
+            channel = c & ~STREAM_MARKER;
+            continue;
+        }
+        if (channel == STREAM_CHANNEL_CONTROL) {
+            fputc(c, stderr);
+            continue;
+        }
+        if (length + 1 < size) {
+            line[length++] = c;
+        }
+        if (c == '\n') {
+            line[length] = '\0';
+            return true;
+        }
+    }
+    return false;
+}
+
+static int record(const char *input_path, const char *output_path, uint32_t rate, unsigned long baud) {
+    FILE *input = strcmp(input_path, "-") == 0 ? stdin : fopen(input_path, "r");
+    if (input == NULL) {
+        fail(input_path);
+    }
+    if (isatty(fileno(input))) {
+        configure_terminal(fileno(input), baud);
+    }
+
+    FILE *output = fopen(output_path, "wb");
+    if (output == NULL) {
+        fail(output_path);
+    }
+
+    uint64_t start = now_microseconds();
+    uint8_t header[HEADER_SIZE] = { 0 };
+    memcpy(header, FILE_MAGIC, 8);
+    put_u16(header + 8, FILE_VERSION);
+    put_u16(header + 10, 1);
+    put_u32(header + 12, rate);
+    put_u64(header + 16, start);
+    if (fwrite(header, HEADER_SIZE, 1, output) != 1) {
+        fail("erro na escrita");
+    }
+
+    // Ctrl-C encerra a captura, escrevendo o índice
+    struct sigaction action = { .sa_handler = on_interrupt };
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    // Taxa informada pelo primeiro cabeçalho do stream, e se as linhas seguintes
+    // ao último cabeçalho são amostras. Logs sem cabeçalho só têm amostras
+    uint32_t stream_rate = 0;
+    bool raw = true;
+
+    // O stream atual tem um único canal (ADC0)
+    char line[64];
+    uint64_t sequence = 0;
+    while (!interrupted && read_data_line(input, line, sizeof(line))) {
+        if (strncmp(line, "#stream ", 8) == 0) {
+            char *field = strstr(line, " r=");
+            if (field != NULL && stream_rate == 0) {
+                stream_rate = strtoul(field + 3, NULL, 10);
+            }
+            field = strstr(line, " enc=");
+            raw = field != NULL && strncmp(field + 5, "raw", 3) == 0
+                && (field[8] == '\r' || field[8] == '\n' || field[8] == ' ');
+            continue;
+        }
+        if (!raw) {
+            continue;
+        }
+
+        char *end;
+        unsigned long value = strtoul(line, &end, 10);
+        if (line[0] < '0' || line[0] > '9' || (*end != '\r' && *end != '\n') || value > 0xFFFF) {
+            // Respostas a comandos e linhas corrompidas são ignoradas
+            continue;
+        }
+        uint64_t time = rate != 0 ? start + sequence * 1000000 / rate : now_microseconds();
+        add_sample(output, 0, value, time);
+        sequence += 1;
+    }
+
+    for (uint16_t channel = 0; channel < CHANNELS_MAX; ++channel) {
+        write_chunk(output, channel);
+    }
+    write_index(output);
+
+    // Sem `-r`, o arquivo fica com a taxa informada pelo stream
+    if (rate == 0 && stream_rate != 0) {
+        put_u32(header + 12, stream_rate);
+        if (fseek(output, 12, SEEK_SET) != 0 || fwrite(header + 12, 4, 1, output) != 1) {
+            fail("erro na escrita");
+        }
+    }
+    fclose(output);
+
+    fprintf(stderr, "%" PRIu64 " amostras em %zu chunks\n", sequence, entries_count);
+    return 0;
+}
+
+
+// Leitura
+
+// Captura mapeada na memória
+struct capture {
+    const uint8_t *data;
+    size_t size;
+    uint32_t rate;
+    uint64_t start;
+    struct index_entry *index;
+    size_t index_count;
+};
+
+static bool read_index_entry(const struct capture *c, const uint8_t *e, struct index_entry *entry) {
+    entry->offset = get_u64(e);
+    entry->first_sequence = get_u64(e + 8);
+    entry->last_sequence = get_u64(e + 16);
+    entry->first_time = get_u64(e + 24);
+    entry->last_time = get_u64(e + 32);
+    entry->channel = get_u16(e + 40);
+    entry->count = get_u32(e + 44);
+    return entry->offset + CHUNK_HEADER_SIZE <= c->size
+        && memcmp(c->data + entry->offset, CHUNK_MAGIC, 4) == 0;
+}
+
+// Reconstrói o índice percorrendo os chunks (captura sem rodapé). Os
+// instantes são estimados pela taxa de amostragem
+static void rebuild_index(struct capture *c) {
+    size_t capacity = 1024;
+    c->index = malloc(capacity * sizeof(*c->index));
+    c->index_count = 0;
+
+    size_t offset = HEADER_SIZE;
+    while (offset + CHUNK_HEADER_SIZE <= c->size
+            && memcmp(c->data + offset, CHUNK_MAGIC, 4) == 0) {
+        const uint8_t *chunk = c->data + offset;
+        uint32_t count = get_u32(chunk + 8);
+        uint32_t size = get_u32(chunk + 12);
+        if (count == 0 || count > CHUNK_SAMPLES || offset + CHUNK_HEADER_SIZE + size > c->size) {
+            break;
+        }
+
+        if (c->index_count == capacity) {
+            capacity *= 2;
+            c->index = realloc(c->index, capacity * sizeof(*c->index));
+        }
+        uint64_t first = get_u64(chunk + 16);
+        uint64_t period = c->rate != 0 ? 1000000 / c->rate : 0;
+        c->index[c->index_count++] = (struct index_entry) {
+            .offset = offset,
+            .first_sequence = first,
+            .last_sequence = first + count - 1,
+            .first_time = c->start + first * period,
+            .last_time = c->start + (first + count - 1) * period,
+            .channel = get_u16(chunk + 4),
+            .count = count,
+        };
+        offset += CHUNK_HEADER_SIZE + size;
+    }
+    fprintf(stderr, "captura sem índice: %zu chunks recuperados\n", c->index_count);
+}
+
+static void open_capture(const char *path, struct capture *c) {
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        fail(path);
+    }
+    c->size = st.st_size;
+    if (c->size < HEADER_SIZE) {
+        errno = 0;
+        fail(path);
+    }
+    c->data = mmap(NULL, c->size, PROT_READ, MAP_SHARED, fd, 0);
+    if (c->data == MAP_FAILED) {
+        fail(path);
+    }
+    close(fd);
+
+    errno = 0;
+    if (memcmp(c->data, FILE_MAGIC, 8) != 0 || get_u16(c->data + 8) != FILE_VERSION) {
+        fail(path);
+    }
+    c->rate = get_u32(c->data + 12);
+    c->start = get_u64(c->data + 16);
+
+    const uint8_t *footer = c->data + c->size - FOOTER_SIZE;
+    if (c->size < HEADER_SIZE + FOOTER_SIZE || memcmp(footer + 16, INDEX_MAGIC, 8) != 0) {
+        rebuild_index(c);
+        return;
+    }
+
+    uint64_t index_offset = get_u64(footer);
+    c->index_count = get_u64(footer + 8);
+    if (index_offset + c->index_count * INDEX_ENTRY_SIZE + FOOTER_SIZE != c->size) {
+        fail(path);
+    }
+    c->index = malloc(c->index_count * sizeof(*c->index) + 1);
+    for (size_t i = 0; i < c->index_count; ++i) {
+        if (!read_index_entry(c, c->data + index_offset + i * INDEX_ENTRY_SIZE, &c->index[i])) {
+            fail(path);
+        }
+    }
+}
+
+static int info(const char *path) {
+    struct capture c;
+    open_capture(path, &c);
+
+    printf("taxa %" PRIu32 " Hz, início %" PRIu64 " µs, %zu chunks\n", c.rate, c.start, c.index_count);
+    uint64_t samples = 0;
+    for (size_t i = 0; i < c.index_count; ++i) {
+        struct index_entry *e = &c.index[i];
+        printf("canal %u  seq %" PRIu64 "-%" PRIu64 "  t %" PRIu64 "-%" PRIu64 "  %u bits  @%" PRIu64 "\n",
+            e->channel, e->first_sequence, e->last_sequence, e->first_time, e->last_time,
+            c.data[e->offset + 6], e->offset);
+        samples += e->count;
+    }
+    size_t raw = samples * 6;
+    printf("%" PRIu64 " amostras, %zu bytes (%.2f bytes por amostra, %.1fx menor que o texto)\n",
+        samples, c.size, samples ? (double) c.size / samples : 0.0,
+        c.size ? (double) raw / c.size : 0.0);
+    return 0;
+}
+
+static int dump(const char *path, uint16_t channel, bool by_time, uint64_t position, uint64_t n) {
+    struct capture c;
+    open_capture(path, &c);
+
+    // As entradas de um canal estão em ordem crescente de sequência e de
+    // tempo, então a primeira que termina depois da posição é encontrada por
+    // busca binária entre as entradas do canal
+    struct index_entry **channel_index = malloc((c.index_count + 1) * sizeof(*channel_index));
+    size_t channel_count = 0;
+    for (size_t i = 0; i < c.index_count; ++i) {
+        if (c.index[i].channel == channel) {
+            channel_index[channel_count++] = &c.index[i];
+        }
+    }
+
+    size_t low = 0, high = channel_count;
+    while (low < high) {
+        size_t middle = (low + high) / 2;
+        uint64_t last = by_time ? channel_index[middle]->last_time : channel_index[middle]->last_sequence;
+        if (last < position) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    static uint16_t samples[CHUNK_SAMPLES];
+    for (size_t i = low; i < channel_count && n > 0; ++i) {
+        struct index_entry *e = channel_index[i];
+        decode_chunk(c.data + e->offset, samples);
+
+        uint32_t first = 0;
+        if (i == low) {
+            if (by_time) {
+                // Dentro do chunk, o instante é interpolado linearmente
+                while (first < e->count && e->count > 1
+                        && e->first_time + (e->last_time - e->first_time) * first / (e->count - 1) < position) {
+                    first += 1;
+                }
+            } else if (position > e->first_sequence) {
+                first = position - e->first_sequence;
+            }
+        }
+        for (uint32_t j = first; j < e->count && n > 0; ++j, --n) {
+            printf("%" PRIu64 " %u\n", e->first_sequence + j, samples[j]);
+        }
+    }
+    return 0;
+}
+
+
+int main(int argc, char **argv) {
+    if (argc >= 4 && strcmp(argv[1], "record") == 0) {
+        uint32_t rate = 0;
+        unsigned long baud = 9600;
+        for (int i = 4; i + 1 < argc; i += 2) {
+            if (strcmp(argv[i], "-r") == 0) {
+                rate = strtoul(argv[i+1], NULL, 0);
+            } else if (strcmp(argv[i], "-b") == 0) {
+                baud = strtoul(argv[i+1], NULL, 0);
+            }
+        }
+        return record(argv[2], argv[3], rate, baud);
+    }
+
+    if (argc == 3 && strcmp(argv[1], "info") == 0) {
+        return info(argv[2]);
+    }
+
+    if (argc >= 3 && strcmp(argv[1], "dump") == 0) {
+        uint16_t channel = 0;
+        bool by_time = false;
+        uint64_t position = 0;
+        uint64_t n = UINT64_MAX;
+        for (int i = 3; i + 1 < argc; i += 2) {
+            if (strcmp(argv[i], "-c") == 0) {
+                channel = strtoul(argv[i+1], NULL, 0);
+            } else if (strcmp(argv[i], "-s") == 0) {
+                position = strtoull(argv[i+1], NULL, 0);
+            } else if (strcmp(argv[i], "-t") == 0) {
+                by_time = true;
+                position = strtoull(argv[i+1], NULL, 0);
+            } else if (strcmp(argv[i], "-n") == 0) {
+                n = strtoull(argv[i+1], NULL, 0);
+            }
+        }
+        return dump(argv[2], channel, by_time, position, n);
+    }
+
+    fprintf(stderr,
+        "uso: %s record <entrada> <arquivo> [-r taxa] [-b baud]\n"
+        "     %s info <arquivo>\n"
+        "     %s dump <arquivo> [-c canal] [-s sequência | -t µs] [-n quantidade]\n",
+        argv[0], argv[0], argv[0]);
+    return 1;
+}
@@ -0,0 +1,192 @@
+/**
+ * Decodificador da serial de depuração (ver `include/debug.h`), que
+ * reconstitui o texto dos registros binários do log (ver `include/log.h`).
+ *
+ * A tabela de mensagens (`include/log_messages.h`) é compilada aqui, então o
+ * decodificador deve ser compilado a partir da mesma versão do firmware que
+ * gerou o log. Cada registro é escrito em uma linha, precedido de "log: ".
+ * Bytes sem o bit 7 fora de um registro (o firmware só os transmite no meio de
+ * um, então aparecem quando a leitura começa no meio do stream) são copiados
+ * para a saída padrão como chegam, e o registro seguinte começa uma nova
+ * linha.
+ *
+ * Compilação:
+ *
+ *     cc -O2 -Iinclude -o decode tools/decode.c
+ *
+ * Uso:
+ *
+ *     decode [entrada] [-b baud]
+ *
+ * `entrada` é a serial de depuração, um arquivo gravado dela, ou "-" (o
+ * padrão) para a entrada padrão. Se for um terminal, ele é configurado no
+ * modo raw com o baud rate `-b` (padrão: 9600). No simavr, os bytes da
+ * serial de depuração são gravados por `tools/sim.c -d <baud> -o <arquivo>`.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "log_messages.h"
+
+
+// Marcador do primeiro byte de um registro (ver `include/log.h`)
+#define LOG_RECORD_MARKER 0x80
+
+// Quantidade máxima de argumentos de uma mensagem
+#define MAX_ARGUMENTS 2
+
+
+// Mensagens, na ordem da tabela
+static const struct {
+    const char *name;
+    int arguments;
+    const char *format;
+} messages[] = {
+#define LOG_MESSAGE(name, arguments, format) { #name, arguments, format },
+    LOG_MESSAGES
+#undef LOG_MESSAGE
+};
+
+#define MESSAGES_NUMBER ((int) (sizeof(messages) / sizeof(messages[0])))
+
+
+static void fail(const char *message) {
+    perror(message);
+    exit(1);
+}
+
+// Configura um terminal no modo raw, com o baud rate dado
+static void configure_terminal(int fd, unsigned long baud) {
+    struct termios tio;
+    if (tcgetattr(fd, &tio) != 0) {
+        fail("não foi possível configurar o terminal");
+    }
+    cfmakeraw(&tio);
+    speed_t speed = baud == 2400 ? B2400 : baud == 4800 ? B4800
+        : baud == 19200 ? B19200 : baud == 38400 ? B38400 : B9600;
+    cfsetispeed(&tio, speed);
+    cfsetospeed(&tio, speed);
+    if (tcsetattr(fd, TCSANOW, &tio) != 0) {
+        fail("não foi possível configurar o terminal");
+    }
+}
+
+// Confere se as conversões de cada formato correspondem à quantidade de
+// argumentos da tabela
+static void check_messages(void) {
+    for (int i = 0; i < MESSAGES_NUMBER; ++i) {
+        int conversions = 0;
+        for (const char *c = messages[i].format; *c != '\0'; ++c) {
+            if (c[0] != '%') {
+                continue;
+            }
+            if (c[1] != '\0' && strchr("udxc", c[1]) != NULL) {
+                conversions += 1;
+            } else if (c[1] != '%') {
+                fprintf(stderr, "conversão inválida em %s: \"%s\"\n",
+                    messages[i].name, messages[i].format);
+                exit(1);
+            }
+            c += 1;
+        }
+        if (conversions != messages[i].arguments || conversions > MAX_ARGUMENTS) {
+            fprintf(stderr, "%s tem %d argumentos e %d conversões\n",
+                messages[i].name, messages[i].arguments, conversions);
+            exit(1);
+        }
+    }
+}
+
+// Escreve uma mensagem, aplicando o formato aos argumentos
+static void print_message(int id, const uint16_t *arguments) {
+    const char *c = messages[id].format;
+    int next = 0;
+    fputs("log: ", stdout);
+    for (; *c != '\0'; ++c) {
+        if (c[0] != '%') {
+            putchar(*c);
+            continue;
+        }
+        c += 1;
+        switch (*c) {
+            case 'u': printf("%u", arguments[next++]); break;
+            case 'd': printf("%d", (int16_t) arguments[next++]); break;
+            case 'x': printf("0x%04x", arguments[next++]); break;
+            case 'c': putchar(arguments[next++] & 0xFF); break;
+            default: putchar('%'); break;
+        }
+    }
+    putchar('\n');
+}
+
+int main(int argc, char **argv) {
+    const char *input_path = "-";
+    unsigned long baud = 9600;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-b") == 0 && i+1 < argc) {
+            baud = strtoul(argv[++i], NULL, 0);
+        } else if (argv[i][0] != '-' || strcmp(argv[i], "-") == 0) {
+            input_path = argv[i];
+        } else {
+            fprintf(stderr, "uso: %s [entrada] [-b baud]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    check_messages();
+
+    FILE *input = strcmp(input_path, "-") == 0 ? stdin : fopen(input_path, "rb");
+    if (input == NULL) {
+        fail(input_path);
+    }
+    if (isatty(fileno(input))) {
+        configure_terminal(fileno(input), baud);
+    }
+
+    // Indica se a saída está no início de uma linha
+    bool line_start = true;
+    int c;
+    while ((c = getc(input)) != EOF) {
+        if (!(c & LOG_RECORD_MARKER)) {
+            putchar(c);
+            line_start = c == '\n';
+            fflush(stdout);
+            continue;
+        }
+
+        int id = c & ~LOG_RECORD_MARKER;
+        if (!line_start) {
+            putchar('\n');
+            line_start = true;
+        }
+        if (id >= MESSAGES_NUMBER) {
+            // Firmware mais novo que a tabela: o tamanho do registro é
+            // desconhecido, e os bytes seguintes são lidos como texto
+            printf("log: mensagem desconhecida %d\n", id);
+            continue;
+        }
+
+        uint16_t arguments[MAX_ARGUMENTS];
+        bool complete = true;
+        for (int i = 0; i < messages[id].arguments && complete; ++i) {
+            int low = getc(input);
+            int high = low == EOF ? EOF : getc(input);
+            complete = high != EOF;
+            arguments[i] = (uint16_t) (low | high << 8);
+        }
+        if (!complete) {
+            printf("log: registro incompleto de %s\n", messages[id].name);
+            break;
+        }
+        print_message(id, arguments);
+        fflush(stdout);
+    }
+
+    return 0;
+}
@@ -0,0 +1,355 @@
+/**
+ * Atualização do programa pela serial, pelo bootloader (ver `include/boot.h`).
+ *
+ * O programa é lido de um arquivo Intel HEX (o `firmware.hex` gerado pelo
+ * PlatformIO) para uma imagem da área do programa, com as posições não
+ * utilizadas apagadas (0xFF). Com `-b`, o comando 'B' é enviado antes no baud
+ * rate do programa, para que ele resete no bootloader; sem `-b`, a placa já
+ * deve estar no bootloader (sem programa, ou com um break na linha durante o
+ * reset).
+ *
+ * A atualização é feita em `BOOT_BAUD_RATE`:
+ *
+ * 1. o CRC de cada página gravada é lido e comparado com o da imagem, o que
+ *    custa 4 bytes por página em vez de 130;
+ * 2. caso alguma página tenha mudado, a primeira página é apagada antes de
+ *    qualquer outra ser gravada, e gravada por último. Uma atualização
+ *    interrompida deixa o vetor de reset apagado, e a placa fica no
+ *    bootloader no próximo reset, em vez de executar um programa pela metade;
+ * 3. cada página diferente é transmitida com o seu CRC e gravada, com até
+ *    `RETRIES` retransmissões;
+ * 4. o bootloader salta para o programa.
+ *
+ * Um programa de 30 KB inteiramente novo leva cerca de 5 s a 125000 baud
+ * (2,5 s de transmissão e 9 ms de escrita por página).
+ * Mudar uma macro como `SAMPLING_RATE` altera poucas páginas, e leva uma
+ * fração de segundo além do reset.
+ *
+ * O baud rate de 125000 não é um dos valores padrão do termios, então é
+ * configurado com o `termios2` do Linux (`BOTHER`), suportado pelos
+ * conversores USB-serial comuns.
+ *
+ * Compilação:
+ *
+ *     cc -O2 -o flash tools/flash.c
+ *
+ * Uso:
+ *
+ *     flash <serial> <firmware.hex> [-b]
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <asm/termbits.h>
+
+
+// Parâmetros do bootloader e do programa (ver `include/boot.h` e
+// `include/config.h`). `boot.h` depende dos cabeçalhos do AVR, então os
+// valores são repetidos aqui
+#define BOOT_VERSION 1
+#define BOOT_BAUD_RATE 125000
+#define PAGE_SIZE 128
+#define APP_PAGES 240
+#define APP_BAUD_RATE 9600
+
+#define BOOT_INFO 'I'
+#define BOOT_CRC 'C'
+#define BOOT_WRITE 'W'
+#define BOOT_RUN 'R'
+
+#define BOOT_OK 'K'
+#define BOOT_SAME 'S'
+#define BOOT_BAD_CRC 'E'
+
+// Tempo máximo de espera por uma resposta (em décimos de segundo), tempo dado
+// ao programa para resetar no bootloader (em µs) e quantidade de
+// retransmissões de uma página
+#define RESPONSE_TIMEOUT 10
+#define BOOT_DELAY 100000
+#define RETRIES 3
+
+
+static uint8_t image[APP_PAGES * PAGE_SIZE];
+
+
+static void fail(const char *message) {
+    perror(message);
+    exit(1);
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// CRC-16 (XMODEM), o mesmo de `_crc_xmodem_update` da avr-libc
+static uint16_t crc_xmodem_update(uint16_t crc, uint8_t data) {
+    crc ^= (uint16_t) data << 8;
+    for (int i = 0; i < 8; ++i) {
+        crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    return crc;
+}
+
+static uint16_t page_crc(const uint8_t *page) {
+    uint16_t crc = 0;
+    for (int i = 0; i < PAGE_SIZE; ++i) {
+        crc = crc_xmodem_update(crc, page[i]);
+    }
+    return crc;
+}
+
+static unsigned hex_byte(const char *text) {
+    unsigned value;
+    if (sscanf(text, "%2x", &value) != 1) {
+        fprintf(stderr, "arquivo HEX inválido\n");
+        exit(1);
+    }
+    return value;
+}
+
+// Lê um arquivo Intel HEX para a imagem. Retorna a quantidade de bytes
+// utilizados (até o fim do último registro de dados)
+static size_t read_hex(const char *path) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        fail(path);
+    }
+    memset(image, 0xFF, sizeof(image));
+
+    size_t used = 0;
+    uint32_t base = 0;
+    char line[600];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        if (line[0] != ':') {
+            continue;
+        }
+        unsigned count = hex_byte(line + 1);
+        uint32_t address = hex_byte(line + 3) << 8 | hex_byte(line + 5);
+        unsigned type = hex_byte(line + 7);
+        uint8_t checksum = count + (address >> 8) + address + type;
+        uint8_t data[256];
+        for (unsigned i = 0; i < count; ++i) {
+            data[i] = hex_byte(line + 9 + 2*i);
+            checksum += data[i];
+        }
+        if ((uint8_t) (checksum + hex_byte(line + 9 + 2*count)) != 0) {
+            fprintf(stderr, "checksum incorreto no arquivo HEX: %s", line);
+            exit(1);
+        }
+
+        if (type == 0x00) {
+            address += base;
+            if (address + count > sizeof(image)) {
+                fprintf(stderr, "o programa ultrapassa a área do programa (%zu bytes)\n", sizeof(image));
+                exit(1);
+            }
+            memcpy(image + address, data, count);
+            if (address + count > used) {
+                used = address + count;
+            }
+        } else if (type == 0x01) {
+            break;
+        } else if (type == 0x02 && count == 2) {
+            base = (data[0] << 8 | data[1]) << 4;
+        } else if (type == 0x04 && count == 2) {
+            base = (uint32_t) (data[0] << 8 | data[1]) << 16;
+        }
+    }
+
+    fclose(file);
+    return used;
+}
+
+
+// Configura a serial no modo raw, 8N1, com o baud rate dado (qualquer valor)
+static void set_baud_rate(int fd, unsigned baud) {
+    struct termios2 tio;
+    if (ioctl(fd, TCGETS2, &tio) != 0) {
+        fail("não foi possível configurar a serial");
+    }
+    tio.c_iflag = 0;
+    tio.c_oflag = 0;
+    tio.c_lflag = 0;
+    tio.c_cflag = CS8 | CREAD | CLOCAL | BOTHER;
+    tio.c_ispeed = baud;
+    tio.c_ospeed = baud;
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = RESPONSE_TIMEOUT;
+    if (ioctl(fd, TCSETS2, &tio) != 0) {
+        fail("não foi possível configurar a serial");
+    }
+}
+
+static void write_all(int fd, const uint8_t *data, size_t size) {
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+        if (written < 0) {
+            fail("erro na escrita da serial");
+        }
+        data += written;
+        size -= written;
+    }
+}
+
+// Lê exatamente `size` bytes, ou retorna falso ao fim do tempo de espera
+static bool read_all(int fd, uint8_t *data, size_t size) {
+    while (size > 0) {
+        ssize_t n = read(fd, data, size);
+        if (n < 0 && errno != EINTR) {
+            fail("erro na leitura da serial");
+        }
+        if (n == 0) {
+            return false;
+        }
+        if (n > 0) {
+            data += n;
+            size -= n;
+        }
+    }
+    return true;
+}
+
+static void expect(bool ok, const char *message) {
+    if (!ok) {
+        fprintf(stderr, "%s\n", message);
+        exit(1);
+    }
+}
+
+// Transmite e grava uma página, com retransmissões. Retorna a resposta final
+static uint8_t write_page(int fd, uint8_t index, const uint8_t *page) {
+    uint16_t crc = page_crc(page);
+    uint8_t message[PAGE_SIZE + 4];
+    message[0] = BOOT_WRITE;
+    message[1] = index;
+    memcpy(message + 2, page, PAGE_SIZE);
+    message[PAGE_SIZE + 2] = crc;
+    message[PAGE_SIZE + 3] = crc >> 8;
+
+    uint8_t response = 0;
+    for (int attempt = 0; attempt <= RETRIES; ++attempt) {
+        write_all(fd, message, sizeof(message));
+        if (!read_all(fd, &response, 1)) {
+            // Um byte perdido deixa o bootloader esperando o resto da página.
+            // Ela é completada com zeros, que não são comandos, e a resposta
+            // (um CRC incorreto) é descartada
+            uint8_t padding[sizeof(message)] = { 0 };
+            write_all(fd, padding, sizeof(padding));
+            usleep(BOOT_DELAY);
+            ioctl(fd, TCFLSH, TCIOFLUSH);
+            continue;
+        }
+        if (response != BOOT_BAD_CRC) {
+            return response;
+        }
+    }
+    return response;
+}
+
+
+int main(int argc, char **argv) {
+    const char *serial_path = NULL;
+    const char *hex_path = NULL;
+    bool request = false;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-b") == 0) {
+            request = true;
+        } else if (serial_path == NULL) {
+            serial_path = argv[i];
+        } else if (hex_path == NULL) {
+            hex_path = argv[i];
+        } else {
+            hex_path = NULL;
+            break;
+        }
+    }
+    if (serial_path == NULL || hex_path == NULL) {
+        fprintf(stderr, "uso: %s <serial> <firmware.hex> [-b]\n", argv[0]);
+        return 1;
+    }
+
+    size_t used = read_hex(hex_path);
+
+    int fd = open(serial_path, O_RDWR | O_NOCTTY);
+    if (fd < 0) {
+        fail(serial_path);
+    }
+
+    double start = now_seconds();
+
+    if (request) {
+        set_baud_rate(fd, APP_BAUD_RATE);
+        write_all(fd, (const uint8_t *) "B\r", 2);
+        // Espera os bytes saírem (o `tcdrain` do termios)
+        ioctl(fd, TCSBRK, 1);
+        usleep(BOOT_DELAY);
+    }
+    set_baud_rate(fd, BOOT_BAUD_RATE);
+    ioctl(fd, TCFLSH, TCIOFLUSH);
+
+    // Sincronização: o bootloader ignora bytes que não são comandos
+    uint8_t info[3];
+    bool synced = false;
+    for (int attempt = 0; attempt <= RETRIES && !synced; ++attempt) {
+        write_all(fd, (const uint8_t *) "I", 1);
+        synced = read_all(fd, info, 3);
+    }
+    expect(synced, "o bootloader não respondeu");
+    expect(info[0] == BOOT_VERSION && info[1] * 2 == PAGE_SIZE && info[2] == APP_PAGES,
+        "versão ou geometria do bootloader incompatível");
+
+    // Páginas diferentes das gravadas
+    bool changed[APP_PAGES];
+    int changed_number = 0;
+    for (int i = 0; i < APP_PAGES; ++i) {
+        uint8_t request_crc[2] = { BOOT_CRC, i };
+        uint8_t crc[2];
+        write_all(fd, request_crc, 2);
+        expect(read_all(fd, crc, 2), "o bootloader não respondeu");
+        changed[i] = (crc[0] | crc[1] << 8) != page_crc(image + i * PAGE_SIZE);
+        changed_number += changed[i];
+    }
+
+    int written = 0;
+    if (changed_number > 0) {
+        // A primeira página é apagada antes das outras, e gravada por último
+        uint8_t erased[PAGE_SIZE];
+        memset(erased, 0xFF, sizeof(erased));
+        uint8_t response = write_page(fd, 0, erased);
+        expect(response == BOOT_OK || response == BOOT_SAME, "falha ao apagar a primeira página");
+
+        for (int i = 1; i <= APP_PAGES; ++i) {
+            int index = i % APP_PAGES;
+            if (!changed[index] && index != 0) {
+                continue;
+            }
+            response = write_page(fd, index, image + index * PAGE_SIZE);
+            if (response != BOOT_OK && response != BOOT_SAME) {
+                fprintf(stderr, "falha ao gravar a página %d (resposta %02x)\n", index, response);
+                return 1;
+            }
+            written += 1;
+        }
+    }
+
+    uint8_t response;
+    write_all(fd, (const uint8_t *) "R", 1);
+    expect(read_all(fd, &response, 1) && response == BOOT_OK, "o bootloader não respondeu");
+
+    fprintf(stderr, "programa de %zu bytes: %d de %d páginas gravadas em %.2f s\n",
+        used, written, APP_PAGES, now_seconds() - start);
+    close(fd);
+    return 0;
+}
@@ -0,0 +1,257 @@
+/**
+ * Reprodução de traços gravados do ADC pelo processamento das amostras
+ * (`include/pipeline.h`), compilado para o host.
+ *
+ * Cada valor do traço passa por `pipeline_process`, exatamente o mesmo código
+ * executado pelo firmware, sem a espera do Timer0 nem a velocidade da serial.
+ * Ao final, são informados a vazão (amostras e bytes produzidos por segundo) e
+ * um hash (FNV-1a de 64 bits) da saída, que permite comparar rapidamente duas
+ * variantes do processamento sobre os mesmos dados.
+ *
+ * O mesmo traço pode ser injetado no ADC do firmware simulado, com a opção
+ * `-i` do `tools/sim.c`. Como o firmware transmite pela serial a mesma saída
+ * do processamento, a equivalência entre as duas execuções é verificada
+ * passando a saída do simavr para `-e`:
+ *
+ *     sim firmware.elf -i traço.txt > sim.out
+ *     replay traço.txt -e sim.out
+ *
+ * Compilação:
+ *
+ *     cc -O2 -Iinclude -o replay tools/replay.c src/pipeline.c
+ *
+ * Uso:
+ *
+ *     replay <traço> [-o saída] [-e esperado] [-r repetições]
+ *
+ *     -o  escreve a saída do processamento no arquivo
+ *     -e  compara a saída com o arquivo, informando a primeira diferença (a
+ *         comparação termina no fim do menor dos dois, pois a simulação pode
+ *         ser encerrada antes do fim do traço)
+ *     -r  processa o traço várias vezes, para medir a vazão com mais dados
+ *
+ * O traço é um arquivo de texto (ou "-" para a entrada padrão) com uma
+ * amostra por linha. É utilizado o último número de cada linha, então tanto o
+ * stream da serial ("0123") quanto a saída de `capture dump` ("sequência
+ * valor") servem como traço.
+ *
+ * No traço e no arquivo esperado, só o canal de dados da serial é
+ * considerado (ver `include/usart.h`), e as linhas de aviso "#..." são
+ * ignoradas, então a saída gravada da serial pode ser usada diretamente.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "pipeline.h"
+
+
+#define FNV_OFFSET 0xcbf29ce484222325ull
+#define FNV_PRIME 0x100000001b3ull
+
+// Marcador de troca de canal da serial e o canal de dados (ver
+// `include/usart.h`)
+#define STREAM_MARKER 0x80
+#define STREAM_CHANNEL_DATA 0
+
+
+// Impede que o compilador descarte as repetições
+volatile uint8_t replay_sink;
+
+
+static void fail(const char *message) {
+    perror(message);
+    exit(1);
+}
+
+// Lê um arquivo inteiro, mantendo só o canal de dados da serial, sem as
+// linhas de aviso "#..."
+static uint8_t *read_data_stream(const char *path, size_t *size) {
+    FILE *file = strcmp(path, "-") == 0 ? stdin : fopen(path, "rb");
+    if (file == NULL) {
+        fail(path);
+    }
+
+    size_t capacity = 65536;
+    uint8_t *data = malloc(capacity);
+    *size = 0;
+
+    int channel = STREAM_CHANNEL_DATA;
+    bool line_start = true;
+    bool skip_line = false;
+    int c;
+    while ((c = getc(file)) != EOF) {
+        if (c & STREAM_MARKER) {
+            channel = c & ~STREAM_MARKER;
+            continue;
+        }
+        if (channel != STREAM_CHANNEL_DATA) {
+            continue;
+        }
+        if (line_start) {
+            skip_line = c == '#';
+        }
+        line_start = c == '\n';
+        if (skip_line) {
+            continue;
+        }
+
+        if (*size == capacity) {
+            capacity *= 2;
+            data = realloc(data, capacity);
+            if (data == NULL) {
+                fail("memória insuficiente");
+            }
+        }
+        data[(*size)++] = c;
+    }
+
+    if (file != stdin) {
+        fclose(file);
+    }
+    return data;
+}
+
+// Lê o traço inteiro para a memória
+static uint16_t *read_trace(const char *path, size_t *count) {
+    size_t size;
+    uint8_t *data = read_data_stream(path, &size);
+
+    size_t capacity = 65536;
+    uint16_t *trace = malloc(capacity * sizeof(*trace));
+    *count = 0;
+
+    // Último número de cada linha
+    bool has_number = false;
+    uint32_t number = 0;
+    uint32_t last = 0;
+    bool in_number = false;
+    for (size_t i = 0; i <= size; ++i) {
+        uint8_t c = i < size ? data[i] : '\n';
+        if (c >= '0' && c <= '9') {
+            number = in_number ? number * 10 + (c - '0') : (uint32_t) (c - '0');
+            in_number = true;
+            continue;
+        }
+        if (in_number) {
+            last = number;
+            has_number = true;
+            in_number = false;
+        }
+        if (c != '\n' || !has_number) {
+            continue;
+        }
+
+        if (*count == capacity) {
+            capacity *= 2;
+            trace = realloc(trace, capacity * sizeof(*trace));
+            if (trace == NULL) {
+                fail("memória insuficiente");
+            }
+        }
+        trace[(*count)++] = last;
+        has_number = false;
+    }
+
+    free(data);
+    return trace;
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+int main(int argc, char **argv) {
+    const char *trace_path = NULL;
+    const char *output_path = NULL;
+    const char *expected_path = NULL;
+    unsigned long repetitions = 1;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-o") == 0 && i+1 < argc) {
+            output_path = argv[++i];
+        } else if (strcmp(argv[i], "-e") == 0 && i+1 < argc) {
+            expected_path = argv[++i];
+        } else if (strcmp(argv[i], "-r") == 0 && i+1 < argc) {
+            repetitions = strtoul(argv[++i], NULL, 0);
+        } else if (trace_path == NULL) {
+            trace_path = argv[i];
+        } else {
+            trace_path = NULL;
+            break;
+        }
+    }
+    if (trace_path == NULL || repetitions == 0) {
+        fprintf(stderr, "uso: %s <traço> [-o saída] [-e esperado] [-r repetições]\n", argv[0]);
+        return 1;
+    }
+
+    size_t count;
+    uint16_t *trace = read_trace(trace_path, &count);
+
+    // A saída de uma passada pelo traço é guardada para ser escrita e
+    // comparada. As repetições só contam para a vazão
+    size_t output_capacity = count * PIPELINE_OUTPUT_MAX;
+    uint8_t *output = malloc(output_capacity + 1);
+    size_t output_size = 0;
+
+    double start = now_seconds();
+    for (unsigned long r = 0; r < repetitions; ++r) {
+        for (size_t i = 0; i < count; ++i) {
+            uint8_t out[PIPELINE_OUTPUT_MAX];
+            uint8_t length = pipeline_process(trace[i], out);
+            if (r == 0) {
+                memcpy(output + output_size, out, length);
+                output_size += length;
+            } else {
+                replay_sink = out[0];
+            }
+        }
+    }
+    double elapsed = now_seconds() - start;
+
+    uint64_t hash = FNV_OFFSET;
+    for (size_t i = 0; i < output_size; ++i) {
+        hash = (hash ^ output[i]) * FNV_PRIME;
+    }
+
+    double samples = (double) count * repetitions;
+    fprintf(stderr, "%zu amostras x %lu em %.3f s: %.1f M amostras/s, %.1f MB/s de saída\n",
+        count, repetitions, elapsed, samples / elapsed / 1e6,
+        (double) output_size * repetitions / elapsed / 1e6);
+    fprintf(stderr, "saída: %zu bytes, hash %016" PRIx64 "\n", output_size, hash);
+
+    if (output_path != NULL) {
+        FILE *file = fopen(output_path, "wb");
+        if (file == NULL || fwrite(output, 1, output_size, file) != output_size) {
+            fail(output_path);
+        }
+        fclose(file);
+    }
+
+    if (expected_path != NULL) {
+        size_t expected_size;
+        uint8_t *expected = read_data_stream(expected_path, &expected_size);
+        size_t compared = 0;
+        while (compared < output_size && compared < expected_size) {
+            if (expected[compared] != output[compared]) {
+                fprintf(stderr, "diferente de %s no byte %zu (amostra %zu)\n",
+                    expected_path, compared, compared / PIPELINE_OUTPUT_MAX);
+                return 2;
+            }
+            compared += 1;
+        }
+        fprintf(stderr, "igual a %s nos primeiros %zu bytes (%zu amostras)\n",
+            expected_path, compared, compared / PIPELINE_OUTPUT_MAX);
+    }
+
+    return 0;
+}
@@ -0,0 +1,618 @@
+/**
+ * Simulação dos programas no simavr, medindo o custo de cada interrupção.
+ *
+ * O programa é executado instrução por instrução. Quando o contador de
+ * programa cai em um endereço da tabela de vetores, é registrada a entrada na
+ * interrupção correspondente; quando o `reti` dessa interrupção é executado, a
+ * quantidade de ciclos gasta desde a entrada é somada às estatísticas do
+ * vetor. Assim, o custo medido inclui o `jmp` do vetor, o prólogo e o epílogo
+ * gerados pelo compilador e o `reti`, sem precisar instrumentar o firmware. O
+ * custo de uma interrupção aninhada entra também no da interrupção que ela
+ * interrompeu.
+ *
+ * Também é medida a latência de cada vetor: os ciclos desde que a interrupção
+ * fica pendente (a flag é setada) até a entrada no vetor. Ela inclui o tempo
+ * em que as interrupções estavam desabilitadas por outra rotina ou pelo
+ * contexto principal, e é a medida usada para comparar as políticas de
+ * aninhamento (ver `include/interrupts.h`), principalmente no vetor ADC.
+ *
+ * Compilação (requer o simavr e a libelf instalados):
+ *
+ *     cc -O2 -o sim tools/sim.c -lsimavr -lelf
+ *
+ * Uso:
+ *
+ *     sim <firmware.elf> [-c ciclos] [-s bytes] [-a milivolts] [-i traço] [-t registrador:bytes] [-d baud [-o arquivo]]
+ *
+ *     -c  quantidade de ciclos simulados (padrão: 10 segundos a 1 MHz)
+ *     -s  bytes enviados para a serial no início da simulação (padrão: "1")
+ *     -a  tensão aplicada na entrada ADC0, em milivolts (padrão: 2500)
+ *     -i  injeta na entrada ADC0 os valores de um traço gravado, um por
+ *         conversão (ver `tools/replay.c`)
+ *     -t  lê periodicamente `bytes` bytes do mapa do TWI, a partir de
+ *         `registrador` (ver `include/twi.h`)
+ *     -d  decodifica a serial de depuração no baud rate dado
+ *     -o  grava os bytes da serial de depuração em `arquivo`, em vez de
+ *         escrevê-los na saída de erro
+ *
+ * Com `-t`, um mestre I2C simulado consulta o firmware a cada
+ * `TWI_POLL_CYCLES` ciclos: escreve o endereço do registrador e, após um
+ * repeated start, lê os bytes, reconhecendo todos menos o último. Cada passo
+ * da transação só é enviado depois que o firmware libera o barramento (TWINT
+ * limpo), como o clock stretching de um barramento real. Os bytes lidos são
+ * escritos na saída de erro, uma linha por transação, por exemplo:
+ *
+ *     sim firmware.elf -t 0x14:9
+ *
+ * lê a quantidade de amostras na fila do TWI seguida de até 4 amostras,
+ * enquanto a amostragem é mantida ligada pelo comando '1' na serial.
+ *
+ * Com `-i`, a cada início de conversão a tensão na entrada ADC0 passa a ser a
+ * do próximo valor do traço (um arquivo de texto com uma amostra por linha, no
+ * mesmo formato aceito pelo `replay`), convertido para milivolts pelo centro
+ * do degrau correspondente. Depois do último valor, o traço recomeça. A vazão
+ * da simulação (amostras por segundo de host) é informada no final.
+ *
+ * Com `-d`, a saída da serial de depuração (pino OC1B, PB2, ver
+ * `include/debug.h`) é decodificada no baud rate dado, amostrando cada bit no
+ * seu centro a partir da borda de descida do start bit, e os bytes recebidos
+ * são escritos na saída de erro. No final, são informados os bytes recebidos,
+ * os erros de frame, o maior desvio de uma borda em relação ao limite de bit
+ * esperado, e o custo da transmissão: os ciclos do vetor TIMER1_COMPB por
+ * byte, e a fração da CPU que ele ocupa com a serial transmitindo sem parar
+ * nesse baud rate. Com `-o`, os bytes recebidos são gravados em um arquivo,
+ * que pode ser decodificado por `tools/decode.c`, já que contêm os registros
+ * binários do log. Por exemplo, com um firmware do ambiente `debug`:
+ *
+ *     sim firmware.elf -d 9600 -o debug.bin -s "s\n"
+ *     decode debug.bin
+ *
+ * Os bytes transmitidos pela serial do firmware são escritos na saída padrão,
+ * e as estatísticas de cada interrupção são escritas na saída de erro.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <simavr/sim_avr.h>
+#include <simavr/sim_cycle_timers.h>
+#include <simavr/sim_elf.h>
+#include <simavr/sim_io.h>
+#include <simavr/sim_interrupts.h>
+#include <simavr/sim_irq.h>
+#include <simavr/avr_adc.h>
+#include <simavr/avr_ioport.h>
+#include <simavr/avr_twi.h>
+#include <simavr/avr_uart.h>
+
+
+// Frequência da CPU (em Hz)
+#define CPU_CLOCK 1000000
+
+// Tensões de alimentação e de referência (em mV)
+#define VCC 5000
+
+// Quantidade de vetores de interrupção do ATmega328p
+#define VECTORS_NUMBER 26
+
+// Opcode da instrução `reti`
+#define RETI_OPCODE 0x9518
+
+// Profundidade máxima de interrupções aninhadas
+#define MAX_NESTING 8
+
+// Endereço de 7 bits do firmware no barramento TWI (ver `include/config.h`)
+#define TWI_ADDRESS 0x28
+
+// Intervalo entre as consultas do mestre TWI e entre os passos de uma
+// transação (um byte a 100 kHz), em ciclos
+#define TWI_POLL_CYCLES 100000
+#define TWI_STEP_CYCLES 90
+
+// Endereço do TWCR na memória de dados, e o bit TWINT
+#define TWCR_ADDRESS 0xBC
+#define TWINT_BIT 7
+
+// Quantidade máxima de bytes lidos em uma transação
+#define TWI_MAX_BYTES 64
+
+// Vetor da interrupção que transmite a serial de depuração
+#define DEBUG_VECTOR 12
+
+
+// Nomes dos vetores de interrupção do ATmega328p
+static const char *vector_names[VECTORS_NUMBER] = {
+    "RESET", "INT0", "INT1", "PCINT0", "PCINT1", "PCINT2", "WDT",
+    "TIMER2_COMPA", "TIMER2_COMPB", "TIMER2_OVF", "TIMER1_CAPT",
+    "TIMER1_COMPA", "TIMER1_COMPB", "TIMER1_OVF", "TIMER0_COMPA",
+    "TIMER0_COMPB", "TIMER0_OVF", "SPI_STC", "USART_RX", "USART_UDRE",
+    "USART_TX", "ADC", "EE_READY", "ANALOG_COMP", "TWI", "SPM_READY",
+};
+
+// Estatísticas de cada vetor
+struct vector_stats {
+    uint64_t count;
+    uint64_t total;
+    uint64_t min;
+    uint64_t max;
+    // Latência desde a interrupção ficar pendente até a entrada no vetor
+    uint64_t latency_count;
+    uint64_t latency_total;
+    uint64_t latency_max;
+};
+
+static struct vector_stats stats[VECTORS_NUMBER];
+
+// Pilha de interrupções em andamento (vetor e ciclo de entrada)
+static struct {
+    int vector;
+    avr_cycle_count_t entry;
+} nesting[MAX_NESTING];
+static int nesting_depth = 0;
+
+// Ciclo em que cada vetor ficou pendente, e se ele ainda está pendente
+static avr_cycle_count_t pending_since[VECTORS_NUMBER];
+static bool pending[VECTORS_NUMBER];
+
+// Simulador, utilizado pelas notificações que não o recebem como parâmetro
+static avr_t *simulated_avr;
+
+
+// Traço injetado na entrada ADC0, e a posição do próximo valor
+static struct {
+    uint16_t *values;
+    size_t count;
+    size_t next;
+    uint64_t injected;
+    avr_irq_t *input;
+} trace;
+
+
+// Mestre TWI simulado: registrador e quantidade de bytes lidos, passo atual da
+// transação e bytes recebidos
+static struct {
+    bool enabled;
+    uint8_t reg;
+    int bytes;
+    int step;
+    int received;
+    uint8_t data[TWI_MAX_BYTES];
+    avr_irq_t *input;
+} twi_master;
+
+
+// Receptor da serial de depuração: duração de um bit (em ciclos), nível atual
+// da linha, início e bit atual do frame em recepção, e as estatísticas
+static struct {
+    bool enabled;
+    uint32_t baud_rate;
+    double bit_cycles;
+    uint32_t level;
+    bool receiving;
+    avr_cycle_count_t start;
+    int bit;
+    uint8_t data;
+    uint64_t bytes;
+    uint64_t framing_errors;
+    double max_edge_error;
+    FILE *output;
+} debug_rx;
+
+
+// Escreve na saída padrão cada byte transmitido pela serial do firmware
+static void uart_output(struct avr_irq_t *irq, uint32_t value, void *param) {
+    (void) irq;
+    (void) param;
+    putchar(value);
+}
+
+
+// Amostra a linha no centro de cada bit do frame em recepção
+static avr_cycle_count_t debug_sample(avr_t *avr, avr_cycle_count_t when, void *param) {
+    (void) avr;
+    (void) when;
+    (void) param;
+    int bit = debug_rx.bit++;
+    if (bit == 0 && debug_rx.level != 0) {
+        // Pulso mais curto que meio bit, não é um start bit
+        debug_rx.framing_errors += 1;
+        debug_rx.receiving = false;
+        return 0;
+    }
+    if (bit >= 1 && bit <= 8) {
+        debug_rx.data |= (debug_rx.level & 1) << (bit - 1);
+    }
+    if (bit == 9) {
+        if (debug_rx.level != 0) {
+            fputc(debug_rx.data, debug_rx.output);
+            debug_rx.bytes += 1;
+        } else {
+            debug_rx.framing_errors += 1;
+        }
+        debug_rx.receiving = false;
+        return 0;
+    }
+    return debug_rx.start + (avr_cycle_count_t) ((bit + 1.5) * debug_rx.bit_cycles);
+}
+
+// Chamada pelo simavr a cada mudança do pino da serial de depuração
+static void debug_edge(struct avr_irq_t *irq, uint32_t value, void *param) {
+    (void) irq;
+    (void) param;
+    avr_cycle_count_t now = simulated_avr->cycle;
+    debug_rx.level = value & 1;
+
+    if (debug_rx.receiving) {
+        // Desvio da borda em relação ao limite de bit mais próximo
+        double offset = (now - debug_rx.start) / debug_rx.bit_cycles;
+        double error = (offset - (int64_t) (offset + 0.5)) * debug_rx.bit_cycles;
+        if (error < 0) {
+            error = -error;
+        }
+        if (error > debug_rx.max_edge_error) {
+            debug_rx.max_edge_error = error;
+        }
+    } else if (debug_rx.level == 0) {
+        debug_rx.receiving = true;
+        debug_rx.start = now;
+        debug_rx.bit = 0;
+        debug_rx.data = 0;
+        avr_cycle_timer_register(simulated_avr,
+            (avr_cycle_count_t) (debug_rx.bit_cycles / 2), debug_sample, NULL);
+    }
+}
+
+
+// Lê o traço, utilizando o último número de cada linha
+static void read_trace(const char *path) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        perror(path);
+        exit(1);
+    }
+    size_t capacity = 65536;
+    trace.values = malloc(capacity * sizeof(*trace.values));
+    char line[128];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        char *last = NULL;
+        for (char *c = line; *c != '\0'; ++c) {
+            if (*c >= '0' && *c <= '9' && (c == line || c[-1] < '0' || c[-1] > '9')) {
+                last = c;
+            }
+        }
+        if (line[0] == '#' || last == NULL) {
+            continue;
+        }
+        if (trace.count == capacity) {
+            capacity *= 2;
+            trace.values = realloc(trace.values, capacity * sizeof(*trace.values));
+        }
+        trace.values[trace.count++] = strtoul(last, NULL, 10);
+    }
+    fclose(file);
+    if (trace.count == 0) {
+        fprintf(stderr, "traço vazio: %s\n", path);
+        exit(1);
+    }
+}
+
+// Chamada pelo simavr no início de cada conversão: aplica o próximo valor do
+// traço na entrada ADC0, no centro do degrau (referência de VCC milivolts)
+static void adc_trigger(struct avr_irq_t *irq, uint32_t value, void *param) {
+    (void) irq;
+    (void) value;
+    (void) param;
+    uint32_t code = trace.values[trace.next];
+    trace.next = trace.next + 1 == trace.count ? 0 : trace.next + 1;
+    trace.injected += 1;
+    avr_raise_irq(trace.input, (code * 2 + 1) * VCC / 2048);
+}
+
+
+// Recebe as mensagens do firmware no barramento TWI, guardando os bytes lidos
+static void twi_output(struct avr_irq_t *irq, uint32_t value, void *param) {
+    (void) irq;
+    (void) param;
+    avr_twi_msg_irq_t message = { .u.v = value };
+    if ((message.u.twi.msg & TWI_COND_READ) && twi_master.received < twi_master.bytes) {
+        twi_master.data[twi_master.received++] = message.u.twi.data;
+    }
+}
+
+// Executa o próximo passo da transação do mestre TWI
+static avr_cycle_count_t twi_step(avr_t *avr, avr_cycle_count_t when, void *param) {
+    (void) param;
+
+    // Enquanto o firmware não libera o barramento, o mestre espera
+    if (avr->data[TWCR_ADDRESS] & (1 << TWINT_BIT)) {
+        return when + TWI_STEP_CYCLES;
+    }
+
+    uint8_t address = TWI_ADDRESS << 1;
+    int step = twi_master.step++;
+    if (step == 0) {
+        // Start, endereço para escrita e endereço do registrador
+        twi_master.received = 0;
+        avr_raise_irq(twi_master.input, avr_twi_irq_msg(TWI_COND_START, address, 0));
+        avr_raise_irq(twi_master.input, avr_twi_irq_msg(TWI_COND_ADDR | TWI_COND_WRITE, address, 0));
+    } else if (step == 1) {
+        avr_raise_irq(twi_master.input, avr_twi_irq_msg(TWI_COND_WRITE, address, twi_master.reg));
+    } else if (step == 2) {
+        // Repeated start e endereço para leitura
+        avr_raise_irq(twi_master.input, avr_twi_irq_msg(TWI_COND_START, address | 1, 0));
+        avr_raise_irq(twi_master.input, avr_twi_irq_msg(TWI_COND_ADDR | TWI_COND_READ, address | 1, 0));
+    } else if (step < 3 + twi_master.bytes) {
+        // Leitura de um byte, reconhecida exceto no último
+        bool last = step == 2 + twi_master.bytes;
+        avr_raise_irq(twi_master.input,
+            avr_twi_irq_msg(TWI_COND_READ | (last ? 0 : TWI_COND_ACK), address | 1, 0));
+    } else {
+        avr_raise_irq(twi_master.input, avr_twi_irq_msg(TWI_COND_STOP, address, 0));
+
+        fprintf(stderr, "twi %02x:", twi_master.reg);
+        for (int i = 0; i < twi_master.received; ++i) {
+            fprintf(stderr, " %02x", twi_master.data[i]);
+        }
+        fprintf(stderr, "\n");
+
+        twi_master.step = 0;
+        return when + TWI_POLL_CYCLES;
+    }
+    return when + TWI_STEP_CYCLES;
+}
+
+
+// Retorna o vetor cujo endereço é `pc`, ou -1 caso `pc` não seja um vetor
+static int vector_at(avr_t *avr, avr_flashaddr_t pc) {
+    if (pc == 0 || pc % avr->vector_size != 0) {
+        return -1;
+    }
+    avr_flashaddr_t vector = pc / avr->vector_size;
+    if (vector >= VECTORS_NUMBER) {
+        return -1;
+    }
+    return vector;
+}
+
+// Chamada pelo simavr quando um vetor fica pendente (valor 1) ou deixa de
+// estar (valor 0)
+static void vector_pending(struct avr_irq_t *irq, uint32_t value, void *param) {
+    (void) irq;
+    int vector = (int) (intptr_t) param;
+    if (value && !pending[vector]) {
+        pending[vector] = true;
+        pending_since[vector] = simulated_avr->cycle;
+    }
+}
+
+static void enter_vector(int vector, avr_cycle_count_t cycle) {
+    if (pending[vector]) {
+        pending[vector] = false;
+        struct vector_stats *s = &stats[vector];
+        uint64_t latency = cycle - pending_since[vector];
+        if (latency > s->latency_max) {
+            s->latency_max = latency;
+        }
+        s->latency_count += 1;
+        s->latency_total += latency;
+    }
+
+    if (nesting_depth == MAX_NESTING) {
+        fprintf(stderr, "aninhamento de interrupções maior que %d\n", MAX_NESTING);
+        exit(1);
+    }
+    nesting[nesting_depth].vector = vector;
+    nesting[nesting_depth].entry = cycle;
+    nesting_depth += 1;
+}
+
+static void leave_vector(avr_cycle_count_t cycle) {
+    if (nesting_depth == 0) {
+        return;
+    }
+    nesting_depth -= 1;
+
+    struct vector_stats *s = &stats[nesting[nesting_depth].vector];
+    uint64_t cycles = cycle - nesting[nesting_depth].entry;
+    if (s->count == 0 || cycles < s->min) {
+        s->min = cycles;
+    }
+    if (cycles > s->max) {
+        s->max = cycles;
+    }
+    s->count += 1;
+    s->total += cycles;
+}
+
+
+static void print_stats(avr_cycle_count_t cycles) {
+    fprintf(stderr, "\n%-14s %10s %8s %8s %8s %8s %10s %10s\n",
+        "vetor", "chamadas", "mín", "média", "máx", "CPU %", "lat média", "lat máx");
+    for (int i = 0; i < VECTORS_NUMBER; ++i) {
+        struct vector_stats *s = &stats[i];
+        if (s->count == 0) {
+            continue;
+        }
+        fprintf(stderr, "%-14s %10" PRIu64 " %8" PRIu64 " %8.1f %8" PRIu64 " %8.3f %10.1f %10" PRIu64 "\n",
+            vector_names[i], s->count, s->min, (double) s->total / s->count,
+            s->max, 100.0 * s->total / cycles,
+            s->latency_count ? (double) s->latency_total / s->latency_count : 0.0,
+            s->latency_max);
+    }
+}
+
+
+int main(int argc, char **argv) {
+    const char *firmware_path = NULL;
+    avr_cycle_count_t cycles = 10 * (avr_cycle_count_t) CPU_CLOCK;
+    const char *input = "1";
+    uint32_t adc_millivolts = 2500;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-c") == 0 && i+1 < argc) {
+            cycles = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-s") == 0 && i+1 < argc) {
+            input = argv[++i];
+        } else if (strcmp(argv[i], "-a") == 0 && i+1 < argc) {
+            adc_millivolts = strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-i") == 0 && i+1 < argc) {
+            read_trace(argv[++i]);
+        } else if (strcmp(argv[i], "-t") == 0 && i+1 < argc) {
+            char *end;
+            twi_master.enabled = true;
+            twi_master.reg = strtoul(argv[++i], &end, 0);
+            twi_master.bytes = *end == ':' ? strtol(end + 1, NULL, 0) : 1;
+            if (twi_master.bytes < 1 || twi_master.bytes > TWI_MAX_BYTES) {
+                firmware_path = NULL;
+                break;
+            }
+        } else if (strcmp(argv[i], "-d") == 0 && i+1 < argc) {
+            debug_rx.enabled = true;
+            debug_rx.baud_rate = strtoul(argv[++i], NULL, 0);
+            if (debug_rx.baud_rate == 0) {
+                firmware_path = NULL;
+                break;
+            }
+            debug_rx.bit_cycles = (double) CPU_CLOCK / debug_rx.baud_rate;
+        } else if (strcmp(argv[i], "-o") == 0 && i+1 < argc) {
+            debug_rx.output = fopen(argv[++i], "wb");
+            if (debug_rx.output == NULL) {
+                perror(argv[i]);
+                return 1;
+            }
+        } else if (firmware_path == NULL) {
+            firmware_path = argv[i];
+        } else {
+            firmware_path = NULL;
+            break;
+        }
+    }
+    if (firmware_path == NULL) {
+        fprintf(stderr, "uso: %s <firmware.elf> [-c ciclos] [-s bytes] [-a milivolts] [-i traço] [-t registrador:bytes] [-d baud [-o arquivo]]\n", argv[0]);
+        return 1;
+    }
+
+    elf_firmware_t firmware;
+    memset(&firmware, 0, sizeof(firmware));
+    if (elf_read_firmware(firmware_path, &firmware) != 0) {
+        fprintf(stderr, "não foi possível ler %s\n", firmware_path);
+        return 1;
+    }
+
+    avr_t *avr = avr_make_mcu_by_name("atmega328p");
+    if (avr == NULL) {
+        fprintf(stderr, "simavr sem suporte ao atmega328p\n");
+        return 1;
+    }
+    avr_init(avr);
+    simulated_avr = avr;
+    avr_load_firmware(avr, &firmware);
+    avr->frequency = CPU_CLOCK;
+    avr->vcc = VCC;
+    avr->avcc = VCC;
+    avr->aref = VCC;
+
+    // Desliga a saída padrão do simavr para a serial, que é tratada aqui
+    uint32_t uart_flags = 0;
+    avr_ioctl(avr, AVR_IOCTL_UART_GET_FLAGS('0'), &uart_flags);
+    uart_flags &= ~AVR_UART_FLAG_STDIO;
+    avr_ioctl(avr, AVR_IOCTL_UART_SET_FLAGS('0'), &uart_flags);
+
+    avr_irq_register_notify(
+        avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_OUTPUT),
+        uart_output, NULL);
+
+    for (int vector = 1; vector < VECTORS_NUMBER; ++vector) {
+        avr_irq_t *irq = avr_get_interrupt_irq(avr, vector);
+        if (irq != NULL) {
+            avr_irq_register_notify(irq + AVR_INT_IRQ_PENDING, vector_pending, (void *) (intptr_t) vector);
+        }
+    }
+
+    avr_irq_t *uart_input = avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_INPUT);
+    for (const char *c = input; *c != '\0'; ++c) {
+        avr_raise_irq(uart_input, (uint8_t) *c);
+    }
+
+    avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_ADC_GETIRQ, ADC_IRQ_ADC0), adc_millivolts);
+
+    if (trace.count > 0) {
+        trace.input = avr_io_getirq(avr, AVR_IOCTL_ADC_GETIRQ, ADC_IRQ_ADC0);
+        avr_irq_register_notify(
+            avr_io_getirq(avr, AVR_IOCTL_ADC_GETIRQ, ADC_IRQ_OUT_TRIGGER),
+            adc_trigger, NULL);
+    }
+
+    if (twi_master.enabled) {
+        twi_master.input = avr_io_getirq(avr, AVR_IOCTL_TWI_GETIRQ(0), TWI_IRQ_INPUT);
+        avr_irq_register_notify(
+            avr_io_getirq(avr, AVR_IOCTL_TWI_GETIRQ(0), TWI_IRQ_OUTPUT),
+            twi_output, NULL);
+        avr_cycle_timer_register(avr, TWI_POLL_CYCLES, twi_step, NULL);
+    }
+
+    if (debug_rx.enabled) {
+        // A linha começa em repouso, com o pull-up do PB2
+        debug_rx.level = 1;
+        if (debug_rx.output == NULL) {
+            debug_rx.output = stderr;
+        }
+        avr_irq_register_notify(
+            avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('B'), 2),
+            debug_edge, NULL);
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    int state = cpu_Running;
+    while (avr->cycle < cycles && state != cpu_Done && state != cpu_Crashed) {
+        avr_flashaddr_t pc = avr->pc;
+        bool is_reti = avr->state == cpu_Running
+            && (avr->flash[pc] | avr->flash[pc+1] << 8) == RETI_OPCODE;
+
+        state = avr_run(avr);
+
+        // O `reti` é tratado antes da entrada, pois uma interrupção pendente
+        // pode ser atendida logo em seguida, na mesma chamada de `avr_run`
+        if (is_reti) {
+            leave_vector(avr->cycle);
+        }
+
+        int vector = vector_at(avr, avr->pc);
+        if (vector >= 0 && avr->pc != pc) {
+            enter_vector(vector, avr->cycle);
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    fflush(stdout);
+    print_stats(avr->cycle);
+
+    if (debug_rx.enabled) {
+        // Custo por byte, e fração da CPU com a serial sempre transmitindo
+        // (um byte a cada 10 bits)
+        double per_byte = debug_rx.bytes
+            ? (double) stats[DEBUG_VECTOR].total / debug_rx.bytes : 0.0;
+        fprintf(stderr, "\ndepuração a %" PRIu32 " baud: %" PRIu64 " bytes, %" PRIu64
+            " erros de frame, desvio máximo das bordas de %.1f ciclos\n",
+            debug_rx.baud_rate, debug_rx.bytes, debug_rx.framing_errors,
+            debug_rx.max_edge_error);
+        fprintf(stderr, "%.1f ciclos por byte, %.1f%% da CPU transmitindo sem parar\n",
+            per_byte, 100.0 * per_byte * debug_rx.baud_rate / 10 / CPU_CLOCK);
+    }
+
+    if (trace.count > 0) {
+        double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+        fprintf(stderr, "\n%" PRIu64 " amostras injetadas em %.3f s: %.0f amostras/s\n",
+            trace.injected, elapsed, trace.injected / elapsed);
+    }
+
+    return state == cpu_Crashed;
+}